@@ -0,0 +1,109 @@
+#include "Builtins.h"
+#include "Environment.h"
+#include "clang/AST/Expr.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cstring>
+
+// Every scalar of the interpreted program lives in one long slot, so the
+// counts taken by the bulk builtins are element counts, not bytes.
+
+static long *argPointer(Environment &env, CallExpr *callexpr, unsigned index) {
+  return reinterpret_cast<long *>(env.getArg(callexpr, index).RValue());
+}
+
+static ObjectV2 builtinGet(Environment &env, CallExpr *callexpr) {
+  // a GET resumed after waiting for input has prompted already
+  if (!env.waitingForInput()) {
+    env.output() << "Please Input an Integer Value : ";
+  }
+  long val;
+  if (!env.readInput(val)) {
+    return ObjectV2();
+  }
+  return ObjectV2(0, 0, val);
+}
+
+static ObjectV2 builtinPrint(Environment &env, CallExpr *callexpr) {
+  env.output() << env.getArg(callexpr, 0).RValue();
+  return ObjectV2();
+}
+
+static ObjectV2 builtinMalloc(Environment &env, CallExpr *callexpr) {
+  long *ptr = env.heapAlloc(env.getArg(callexpr, 0).RValue(), callexpr);
+  return ObjectV2(1, 0, reinterpret_cast<long>(ptr));
+}
+
+static ObjectV2 builtinFree(Environment &env, CallExpr *callexpr) {
+  env.heapFree(argPointer(env, callexpr, 0));
+  return ObjectV2();
+}
+
+/// MEMCPY(dst, src, n): copy n elements, overlapping ranges allowed
+static ObjectV2 builtinMemcpy(Environment &env, CallExpr *callexpr) {
+  long *dst = argPointer(env, callexpr, 0);
+  long *src = argPointer(env, callexpr, 1);
+  long n = env.getArg(callexpr, 2).RValue();
+  checkHeapRange(dst, n);
+  checkHeapRange(src, n);
+  if (n > 0) {
+    std::memmove(dst, src, n * sizeof(long));
+  }
+  return ObjectV2();
+}
+
+/// MEMSET(dst, value, n): store value into n elements
+static ObjectV2 builtinMemset(Environment &env, CallExpr *callexpr) {
+  long *dst = argPointer(env, callexpr, 0);
+  long value = env.getArg(callexpr, 1).RValue();
+  long n = env.getArg(callexpr, 2).RValue();
+  checkHeapRange(dst, n);
+  if (n > 0) {
+    std::fill_n(dst, n, value);
+  }
+  return ObjectV2();
+}
+
+/// MEMCMP(a, b, n): -1, 0 or 1 comparing the first n elements as integers
+static ObjectV2 builtinMemcmp(Environment &env, CallExpr *callexpr) {
+  long *a = argPointer(env, callexpr, 0);
+  long *b = argPointer(env, callexpr, 1);
+  long n = env.getArg(callexpr, 2).RValue();
+  checkHeapRange(a, n);
+  checkHeapRange(b, n);
+  if (n <= 0) {
+    return ObjectV2(0, 0, 0L);
+  }
+  auto diff = std::mismatch(a, a + n, b);
+  if (diff.first == a + n) {
+    return ObjectV2(0, 0, 0L);
+  }
+  return ObjectV2(0, 0, *diff.first < *diff.second ? -1L : 1L);
+}
+
+/// SORT(arr, n): sort n integers in ascending order
+static ObjectV2 builtinSort(Environment &env, CallExpr *callexpr) {
+  long *arr = argPointer(env, callexpr, 0);
+  long n = env.getArg(callexpr, 1).RValue();
+  checkHeapRange(arr, n);
+  if (n > 1) {
+    std::sort(arr, arr + n);
+  }
+  return ObjectV2();
+}
+
+static const llvm::StringMap<BuiltinFn> &registry() {
+  static const llvm::StringMap<BuiltinFn> builtins = {
+      {"FREE", builtinFree},     {"MALLOC", builtinMalloc},
+      {"GET", builtinGet},       {"PRINT", builtinPrint},
+      {"MEMCPY", builtinMemcpy}, {"MEMSET", builtinMemset},
+      {"MEMCMP", builtinMemcmp}, {"SORT", builtinSort},
+  };
+  return builtins;
+}
+
+BuiltinFn lookupBuiltin(llvm::StringRef name) {
+  auto it = registry().find(name);
+  return it == registry().end() ? nullptr : it->second;
+}
@@ -1,31 +1,32 @@
 #include "Environment.h"
-#include "InterpreterVisitor.h"
+#include "Inlining.h"
 #include "ObjectV2.h"
+#include "Storage.h"
+#include "Trace.h"
 #include "clang/AST/ASTConsumer.h"
+#include "clang/AST/ASTContext.h"
 #include "clang/AST/Decl.h"
-#include "clang/AST/EvaluatedExprVisitor.h"
+#include "clang/AST/ExprCXX.h"
 #include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/AST/StmtOpenMP.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Frontend/FrontendAction.h"
 #include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Format.h"
+#include <algorithm>
+#include <chrono>
 #include <cstdlib>
 #include <memory>
+#include <mutex>
 
 const int StackFrame::kNoFather = -1;
-static unsigned getPointerType(QualType ty) {
-  unsigned pointerType = 0;
-  while (const PointerType *pt = dyn_cast<PointerType>(ty.getTypePtr())) {
-    ty = pt->getPointeeType();
-    ++pointerType;
-  }
-  return pointerType;
-}
 
 StackFrame::~StackFrame() {
   if (!mArrs.empty()) {
     // llvm::dbgs() << "destroy stack frame's " << mArrs.size() << " arrays\n";
     for (long *p : mArrs) {
-      delete[] p;
+      freeSlots(p);
     }
     mArrs.clear();
   }
@@ -54,7 +55,7 @@ ObjectV2 StackFrame::getDeclValRef(std::deque<StackFrame> &stack, Decl *name) {
       }
       llvm::errs() << "ID=" << name->getID() << '\n';
 #endif
-      exit(-1);
+      fatal(stack.back().getPC());
     }
 #ifndef NDEBUG
     stackIDs.push_back(curFrame->mFatherID);
@@ -63,65 +64,396 @@ ObjectV2 StackFrame::getDeclValRef(std::deque<StackFrame> &stack, Decl *name) {
   }
 }
 
-void Environment::init(TranslationUnitDecl *unit, InterpreterVisitor *visitor) {
-  mVisitor = visitor;
+void Environment::init(TranslationUnitDecl *unit) {
+  init(std::vector<TranslationUnitDecl *>{unit});
+}
+
+void Environment::init(const std::vector<TranslationUnitDecl *> &units) {
+  for (TranslationUnitDecl *unit : units) {
+    mUnits.push_back(&unit->getASTContext());
+  }
+  if (gShadowHeap != nullptr) {
+    gShadowHeap->setWhere([this] { return mStack.back().getPC(); });
+  }
   mStack.emplace_back(StackFrame::kNoFather);
+  framePushed();
   StackFrame mainStackFrame(0);
-  for (auto i = unit->decls_begin(), e = unit->decls_end(); i != e; ++i) {
-    if (FunctionDecl *fdecl = dyn_cast<FunctionDecl>(*i)) {
-      mStack.back().bindDecl(fdecl, ObjectV2(0, 0, (long)fdecl));
-      if (fdecl->getName().equals("FREE"))
-        mFree = fdecl;
-      else if (fdecl->getName().equals("MALLOC"))
-        mMalloc = fdecl;
-      else if (fdecl->getName().equals("GET"))
-        mInput = fdecl;
-      else if (fdecl->getName().equals("PRINT"))
-        mOutput = fdecl;
+  std::vector<VarDecl *> globals;
+  for (TranslationUnitDecl *unit : units) {
+    declare(std::vector<Decl *>(unit->decls_begin(), unit->decls_end()),
+            globals);
+  }
+  // globals are bound to their definitions before any initializer, which
+  // may take the address of a global of another unit, is evaluated
+  link(units);
+  layOutGlobals(globals);
+  if (mEntry != nullptr) {
+    FunctionInfo &info = mFunctions[mEntry->getCanonicalDecl()];
+    prepare(info, mEntry);
+    ++info.Calls;
+    enterActivation(info, nullptr);
+    // bind main's parameters
+    for (ParmVarDecl *param : info.Definition->parameters()) {
+      if (long *slot = localSlot(param)) {
+        *slot = 0;
+        continue;
+      }
+      unsigned pointerType = getPointerType(param->getType());
+      mainStackFrame.bindDecl(
+          param, ObjectV2(pointerType, 0, 0L)); // TODO: decl value
+    }
+  }
+  mStack.push_back(std::move(mainStackFrame));
+  framePushed();
+}
+
+void Environment::declare(const std::vector<Decl *> &decls) {
+  std::vector<VarDecl *> globals;
+  declare(decls, globals);
+  layOutGlobals(globals);
+}
+
+void Environment::declare(const std::vector<Decl *> &decls,
+                          std::vector<VarDecl *> &globals) {
+  for (Decl *decl : decls) {
+    if (FunctionDecl *fdecl = dyn_cast<FunctionDecl>(decl)) {
+      mStack.front().bindDecl(fdecl, ObjectV2(0, 0, (long)fdecl));
+      if (BuiltinFn fn = lookupBuiltin(fdecl->getName()))
+        mBuiltins[fdecl] = fn;
       else if (fdecl->getName().equals("main")) {
         mEntry = fdecl;
-        // bind main's parameters
-        for (auto *it = fdecl->param_begin(); it != fdecl->param_end(); ++it) {
-          unsigned pointerType = getPointerType((*it)->getType());
-          mainStackFrame.bindDecl(
-              *it, ObjectV2(pointerType, 0, 0L)); // TODO: decl value
-        }
+        mFunctions.emplace(fdecl->getCanonicalDecl(), FunctionInfo());
+      } else {
+        // prepared on its first call
+        mFunctions.emplace(fdecl->getCanonicalDecl(), FunctionInfo());
       }
-      // skip user defined function
-    } else if (VarDecl *vardecl = dyn_cast<VarDecl>(*i)) {
-      Expr *init_expr = vardecl->getInit();
-      QualType tp = vardecl->getType();
-      if (tp->isIntegerType() || tp->isCharType()) {
-        if (init_expr == nullptr) {
-          mStack.back().bindDecl(vardecl, ObjectV2(0, 0, 0L));
-        } else if (IntegerLiteral *int_lit =
-                       dyn_cast<IntegerLiteral>(init_expr)) {
-          mStack.back().bindDecl(
-              vardecl,
-              ObjectV2(0, 0, (long)int_lit->getValue().getSExtValue()));
-        } else if (CharacterLiteral *char_lit =
-                       dyn_cast<CharacterLiteral>(init_expr)) {
-          mStack.back().bindDecl(
-              vardecl,
-              ObjectV2(0, 0, static_cast<long>((char_lit->getValue()))));
-        } else {
-          llvm::errs() << "unimplement literal: "
-                       << init_expr->getStmtClassName();
+    } else if (VarDecl *vardecl = dyn_cast<VarDecl>(decl)) {
+      // laid out once every global is known, as initializers may take the
+      // address of any of them
+      globals.push_back(vardecl);
+    } else if (TypedefDecl *typeDefDecl = dyn_cast<TypedefDecl>(decl)) {
+      // do nothing
+    } else if (isa<RecordDecl>(decl)) {
+      // laid out on first use
+    } else {
+      llvm::errs() << "unimplement decl: " << decl->getDeclKindName() << '\n';
+      fatal(nullptr);
+    }
+  }
+}
+
+void Environment::link(const std::vector<TranslationUnitDecl *> &units) {
+  // what each name refers to outside its translation unit
+  llvm::StringMap<FunctionDecl *> functions;
+  llvm::StringMap<VarDecl *> globals;
+  for (TranslationUnitDecl *unit : units) {
+    for (Decl *decl : unit->decls()) {
+      if (FunctionDecl *fdecl = dyn_cast<FunctionDecl>(decl)) {
+        if (fdecl->isThisDeclarationADefinition() &&
+            fdecl->isExternallyVisible() &&
+            !functions.try_emplace(fdecl->getName(), fdecl->getCanonicalDecl())
+                 .second) {
+          llvm::errs() << "multiple definition of " << fdecl->getName()
+                       << '\n';
+          fatal(nullptr);
+        }
+      } else if (VarDecl *vardecl = dyn_cast<VarDecl>(decl)) {
+        if (!vardecl->isExternallyVisible() ||
+            vardecl->isThisDeclarationADefinition() ==
+                VarDecl::DeclarationOnly) {
+          continue;
         }
-      } else if (tp->isPointerType()) {
-        // TODO: init
+        // a definition wins over tentative ones, e.g. `int g;`, but there
+        // is only one
+        VarDecl *&definition = globals[vardecl->getName()];
+        bool defines =
+            vardecl->isThisDeclarationADefinition() == VarDecl::Definition;
+        if (definition == nullptr) {
+          definition = vardecl;
+        } else if (definition->isThisDeclarationADefinition() !=
+                   VarDecl::Definition) {
+          if (defines) {
+            definition = vardecl;
+          }
+        } else if (defines) {
+          llvm::errs() << "multiple definition of " << vardecl->getName()
+                       << '\n';
+          fatal(nullptr);
+        }
+      }
+    }
+  }
+  for (auto it = mFunctions.begin(); it != mFunctions.end();) {
+    auto definition = functions.find(it->first->getName());
+    if (it->first->getDefinition() == nullptr &&
+        definition != functions.end()) {
+      mFunctionLinks[it->first] = definition->second;
+      it = mFunctions.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  for (TranslationUnitDecl *unit : units) {
+    for (Decl *decl : unit->decls()) {
+      VarDecl *vardecl = dyn_cast<VarDecl>(decl);
+      if (vardecl == nullptr || !vardecl->isExternallyVisible()) {
+        continue;
+      }
+      auto definition = globals.find(vardecl->getName());
+      if (definition != globals.end() && definition->second != vardecl) {
+        mGlobalLinks[vardecl] = definition->second;
+      }
+    }
+  }
+}
+
+FunctionDecl *Environment::functionKey(FunctionDecl *callee) const {
+  FunctionDecl *canonical = callee->getCanonicalDecl();
+  const auto &links = shared().mFunctionLinks;
+  if (links.empty()) {
+    return canonical;
+  }
+  auto link = links.find(canonical);
+  return link == links.end() ? canonical : link->second;
+}
+
+/// Slots a global takes in the data segment. Scalars live in their frame's
+/// ObjectV2 like locals do.
+unsigned Environment::dataSlots(QualType ty) {
+  if (ty->isRecordType() || ty->isConstantArrayType()) {
+    return mLayout.slots(ty);
+  }
+  return 0;
+}
 
-      } else if (tp->isConstantArrayType() && tp->isConstantSizeType()) {
-        arrayType(vardecl, init_expr, tp);
+void Environment::layOutGlobals(const std::vector<VarDecl *> &all) {
+  // only definitions take storage, what links elsewhere uses theirs
+  std::vector<VarDecl *> globals;
+  for (VarDecl *vardecl : all) {
+    if (linkedDecl(vardecl) != vardecl) {
+      continue;
+    }
+    if (vardecl->isThisDeclarationADefinition() == VarDecl::DeclarationOnly) {
+      // e.g. an extern redeclared by the REPL after its definition
+      VarDecl *definition = vardecl->getDefinition();
+      if (definition == nullptr) {
+        definition = vardecl->getActingDefinition();
       }
-    } else if (TypedefDecl *typeDefDecl = dyn_cast<TypedefDecl>(*i)) {
-      // do nothing
+      if (definition == nullptr) {
+        llvm::errs() << "undefined reference to " << vardecl->getName()
+                     << '\n';
+        fatal(nullptr);
+      }
+      mGlobalLinks[vardecl] = definition;
+      continue;
+    }
+    globals.push_back(vardecl);
+  }
+  size_t total = 0;
+  for (VarDecl *vardecl : globals) {
+    total += dataSlots(vardecl->getType());
+  }
+  long *data = nullptr;
+  if (total != 0) {
+    data = allocSlots(total);
+    mStack.front().mArrs.insert(data);
+  }
+  for (VarDecl *vardecl : globals) {
+    bindGlobal(vardecl, data);
+    data += dataSlots(vardecl->getType());
+  }
+  for (VarDecl *vardecl : globals) {
+    initGlobal(vardecl);
+  }
+}
+
+void Environment::defineStatic(VarDecl *vardecl) {
+  if (mStack.front().hasDecl(vardecl)) {
+    return;
+  }
+  long *storage = nullptr;
+  if (unsigned slots = dataSlots(vardecl->getType())) {
+    storage = allocSlots(slots);
+    mStack.front().mArrs.insert(storage);
+  }
+  bindGlobal(vardecl, storage);
+  initGlobal(vardecl);
+}
+
+void Environment::bindGlobal(VarDecl *vardecl, long *storage) {
+  QualType ty = vardecl->getType();
+  long addr = reinterpret_cast<long>(storage);
+  if (ty->isRecordType()) {
+    mStack.front().bindDecl(vardecl, ObjectV2(0, 0, addr));
+  } else if (const ConstantArrayType *array =
+                 dyn_cast_or_null<ConstantArrayType>(
+                     ty->getAsArrayTypeUnsafe())) {
+    unsigned pointerType = getPointerType(array->getElementType());
+    mStack.front().bindDecl(vardecl, ObjectV2(pointerType, 0, addr));
+  } else if (ty->isIntegerType() || ty->isPointerType()) {
+    mStack.front().bindDecl(vardecl, ObjectV2(getPointerType(ty), 0, 0L));
+  } else {
+    llvm::errs() << "unimplemented global " << vardecl->getName() << '\n';
+    fatal(nullptr);
+  }
+}
+
+void Environment::initGlobal(VarDecl *vardecl) {
+  Expr *init_expr = vardecl->getInit();
+  if (init_expr == nullptr) {
+    return;
+  }
+  CXXConstructExpr *ctor = dyn_cast<CXXConstructExpr>(init_expr);
+  if (ctor != nullptr && ctor->getNumArgs() == 0 &&
+      ctor->getConstructor()->isTrivial()) {
+    // zeroed already
+    return;
+  }
+  // evaluating fills caches of the ASTContext, which the sessions of the
+  // server share across threads
+  static std::mutex evalMutex;
+  std::unique_lock<std::mutex> lock(evalMutex);
+  Expr::EvalResult result;
+  if (!init_expr->EvaluateAsRValue(result, vardecl->getASTContext())) {
+    llvm::errs() << "non-constant initializer for " << vardecl->getName()
+                 << '\n';
+    fatal(init_expr);
+  }
+  lock.unlock();
+  storeConstant(globalAddress(vardecl), vardecl->getType(), result.Val);
+}
+
+long *Environment::globalAddress(const ValueDecl *decl) {
+  ObjectV2 var = mStack.front().getDeclValRef(
+      mStack, linkedDecl(const_cast<ValueDecl *>(decl)));
+  QualType ty = decl->getType();
+  if (ty->isRecordType() || ty->isArrayType()) {
+    return reinterpret_cast<long *>(var.RValue());
+  }
+  return reinterpret_cast<long *>(var.AddressOf().RValue());
+}
+
+void Environment::storeConstant(long *dst, QualType ty, const APValue &value) {
+  switch (value.getKind()) {
+  case APValue::None:
+  case APValue::Indeterminate:
+    return;
+  case APValue::Int:
+    *dst = value.getInt().getExtValue();
+    return;
+  case APValue::LValue:
+    *dst = constantAddress(value);
+    return;
+  case APValue::Array: {
+    QualType elem = ty->getAsArrayTypeUnsafe()->getElementType();
+    unsigned stride = mLayout.slots(elem);
+    unsigned n = value.getArrayInitializedElts();
+    for (unsigned i = 0; i < n; ++i) {
+      storeConstant(dst + i * stride, elem, value.getArrayInitializedElt(i));
+    }
+    if (value.hasArrayFiller()) {
+      const APValue &filler = value.getArrayFiller();
+      // the storage is zeroed, and untouched pages stay free
+      if (filler.isInt() && filler.getInt() == 0) {
+        return;
+      }
+      for (unsigned i = n, e = value.getArraySize(); i < e; ++i) {
+        storeConstant(dst + i * stride, elem, filler);
+      }
+    }
+    return;
+  }
+  case APValue::Struct: {
+    const RecordDecl *record = ty->getAs<RecordType>()->getDecl();
+    for (const FieldDecl *field : record->getDefinition()->fields()) {
+      storeConstant(dst + mLayout.field(field).Offset, field->getType(),
+                    value.getStructField(field->getFieldIndex()));
+    }
+    return;
+  }
+  case APValue::Union:
+    if (const FieldDecl *field = value.getUnionField()) {
+      storeConstant(dst + mLayout.field(field).Offset, field->getType(),
+                    value.getUnionValue());
+    }
+    return;
+  default:
+    llvm::errs() << "unimplemented constant initializer\n";
+    fatal(nullptr);
+  }
+}
+
+long Environment::constantAddress(const APValue &value) {
+  if (value.isNullPointer()) {
+    return 0;
+  }
+  APValue::LValueBase base = value.getLValueBase();
+  if (!base) {
+    // an integer cast to a pointer
+    return value.getLValueOffset().getQuantity();
+  }
+  const ValueDecl *decl = base.dyn_cast<const ValueDecl *>();
+  if (decl == nullptr || !isa<VarDecl>(decl) || !value.hasLValuePath()) {
+    llvm::errs() << "unimplemented constant address\n";
+    fatal(nullptr);
+  }
+  // walk the path in slots rather than the byte offset clang computed
+  long *addr = globalAddress(decl);
+  QualType ty = decl->getType();
+  for (const APValue::LValuePathEntry &entry : value.getLValuePath()) {
+    if (const ArrayType *array = ty->getAsArrayTypeUnsafe()) {
+      ty = array->getElementType();
+      addr += entry.getAsArrayIndex() * mLayout.slots(ty);
     } else {
-      llvm::errs() << "unimplement decl: " << i->getDeclKindName();
-      exit(-1);
+      const FieldDecl *field =
+          cast<FieldDecl>(entry.getAsBaseOrMember().getPointer());
+      addr += mLayout.field(field).Offset;
+      ty = field->getType();
     }
   }
-  mStack.push_back(std::move(mainStackFrame));
+  return reinterpret_cast<long>(addr);
+}
+
+void Environment::initAggregate(long *dst, Expr *init) {
+  if (InitListExpr *list = dyn_cast<InitListExpr>(init)) {
+    QualType ty = list->getType();
+    if (const ArrayType *array = ty->getAsArrayTypeUnsafe()) {
+      unsigned stride = layout().slots(array->getElementType());
+      for (unsigned i = 0, n = list->getNumInits(); i < n; ++i) {
+        initAggregate(dst + i * stride, list->getInit(i));
+      }
+    } else if (const FieldDecl *field = list->getInitializedFieldInUnion()) {
+      initAggregate(dst + layout().field(field).Offset, list->getInit(0));
+    } else {
+      const RecordDecl *record = ty->getAs<RecordType>()->getDecl();
+      unsigned i = 0;
+      for (const FieldDecl *field : record->getDefinition()->fields()) {
+        if (i == list->getNumInits()) {
+          break;
+        }
+        initAggregate(dst + layout().field(field).Offset, list->getInit(i++));
+      }
+    }
+    return;
+  }
+  if (init == nullptr || isa<ImplicitValueInitExpr>(init)) {
+    // the storage is zeroed
+    return;
+  }
+  if (isa<StringLiteral>(init)) {
+    llvm::errs() << "unimplemented string initializer\n";
+    fatal(init);
+  }
+  ObjectV2 value = mStack.back().getStmtVal(init);
+  if (init->getType()->isRecordType()) {
+    long *src = reinterpret_cast<long *>(value.RValue());
+    unsigned slots = layout().slots(init->getType());
+    checkHeapRange(src, slots);
+    checkHeapRange(dst, slots);
+    std::copy_n(src, slots, dst);
+  } else {
+    *dst = value.RValue();
+  }
 }
 
 void Environment::intLiteral(IntegerLiteral *int_lit) {
@@ -144,56 +476,56 @@ void Environment::binop(BinaryOperator *bop) {
   Expr *right = bop->getRHS();
   auto left_value = mStack.back().getStmtVal(left);
   auto right_value = mStack.back().getStmtVal(right);
-  switch (bop->getOpcode()) {
-  case clang::BO_Assign: {
+  BinaryOperatorKind op = bop->getOpcode();
+  if (op == clang::BO_Assign) {
     left_value.Assign(right_value);
-    mStack.back().bindStmt(left, right_value);
-    break;
-  }
-  case clang::BO_Add: {
-    mStack.back().bindStmt(bop, left_value.Add(right_value));
-    break;
-  }
-  case clang::BO_Sub: {
-    mStack.back().bindStmt(bop, left_value.Sub(right_value));
-    break;
-  }
-  case clang::BO_Mul: {
-    mStack.back().bindStmt(bop, left_value.Mul(right_value));
-    break;
-  }
-  case clang::BO_Div: {
-    mStack.back().bindStmt(bop, left_value.Div(right_value));
-    break;
-  }
-  case clang::BO_GE: {
-    mStack.back().bindStmt(bop, left_value.Ge(right_value));
-    break;
-  }
-  case clang::BO_GT: {
-    mStack.back().bindStmt(bop, left_value.Gt(right_value));
-    break;
-  }
-  case clang::BO_LE: {
-    mStack.back().bindStmt(bop, left_value.Le(right_value));
-    break;
-  }
-  case clang::BO_LT: {
-    mStack.back().bindStmt(bop, left_value.Lt(right_value));
-    break;
-  }
-  case clang::BO_EQ: {
-    mStack.back().bindStmt(bop, left_value.Eq(right_value));
-    break;
-  }
-  default: {
-    llvm::errs() << "unimplemented binop "
-                 << BinaryOperator::getOpcodeStr(bop->getOpcode()) << '\n';
-    exit(-1);
+    stepInductions(bop);
+    mStack.back().bindStmt(bop, left_value);
+  } else if (op == clang::BO_Comma) {
+    mStack.back().bindStmt(bop, right_value);
+  } else if (bop->isCompoundAssignmentOp()) {
+    // the LHS was evaluated once, to an lvalue: read, combine and store
+    // through it
+    ObjectV2 result = handler(bop)(left_value, right_value);
+    left_value.Assign(result);
+    stepInductions(bop);
+    mStack.back().bindStmt(bop, left_value);
+  } else {
+    mStack.back().bindStmt(bop, handler(bop)(left_value, right_value));
   }
+}
+
+bool Environment::compare(BinaryOperator *bop) {
+  mStack.back().setPC(bop);
+  long lhs = mStack.back().getStmtVal(bop->getLHS()).RValue();
+  long rhs = mStack.back().getStmtVal(bop->getRHS()).RValue();
+  switch (bop->getOpcode()) {
+  case BO_LT:
+    return lhs < rhs;
+  case BO_GT:
+    return lhs > rhs;
+  case BO_LE:
+    return lhs <= rhs;
+  case BO_GE:
+    return lhs >= rhs;
+  case BO_EQ:
+    return lhs == rhs;
+  default:
+    assert(bop->getOpcode() == BO_NE);
+    return lhs != rhs;
   }
 }
 
+void Environment::logical(BinaryOperator *bop, bool value) {
+  mStack.back().setPC(bop);
+  mStack.back().bindStmt(bop, ObjectV2(0, 0, static_cast<long>(value)));
+}
+
+void Environment::conditional(ConditionalOperator *expr, Expr *arm) {
+  mStack.back().setPC(expr);
+  mStack.back().bindStmt(expr, mStack.back().getStmtVal(arm));
+}
+
 void Environment::unary(UnaryOperator *uop) {
   mStack.back().setPC(uop);
   auto value = mStack.back().getStmtVal(uop->getSubExpr());
@@ -203,17 +535,46 @@ void Environment::unary(UnaryOperator *uop) {
     break;
   }
   case clang::UO_Minus: {
-    mStack.back().bindStmt(uop, value.Minus());
+    mStack.back().bindStmt(uop, ObjectV2(0, 0, -value.RValue()));
+    break;
+  }
+  case clang::UO_LNot: {
+    mStack.back().bindStmt(uop, ObjectV2(0, 0, value.RValue() == 0 ? 1L : 0L));
     break;
   }
   case clang::UO_Deref: {
-    mStack.back().bindStmt(uop, value.Deref());
+    if (uop->getType()->isRecordType()) {
+      // a struct evaluates to its address, the pointer's value
+      mStack.back().bindStmt(uop, ObjectV2(0, 0, value.RValue()));
+    } else {
+      mStack.back().bindStmt(uop, value.Deref());
+    }
+    break;
+  }
+  case clang::UO_AddrOf: {
+    if (uop->getSubExpr()->getType()->isRecordType()) {
+      ObjectV2 ptr(getPointerType(uop->getType()), 0, value.RValue());
+      mStack.back().bindStmt(uop, ptr);
+    } else {
+      mStack.back().bindStmt(uop, value.AddressOf());
+    }
+    break;
+  }
+  case clang::UO_PreInc:
+  case clang::UO_PreDec:
+  case clang::UO_PostInc:
+  case clang::UO_PostDec: {
+    // the operand is an lvalue evaluated once: read and store through it
+    ObjectV2 old = value.ToRValue();
+    value.Assign(handler(uop)(old, ObjectV2(0, 0, 1L)));
+    stepInductions(uop);
+    mStack.back().bindStmt(uop, uop->isPrefix() ? value : old);
     break;
   }
   default: {
     llvm::errs() << "unimplemented unary operator"
                  << UnaryOperator::getOpcodeStr(uop->getOpcode()) << '\n';
-    exit(-1);
+    fatal(mStack.back().getPC());
   }
   }
 }
@@ -226,10 +587,14 @@ void Environment::unaryOrTypeTrait(UnaryExprOrTypeTraitExpr *expr) {
     mStack.back().bindStmt(expr, ObjectV2(0, 0, 4L));
   } else if (ty->isPointerType()) {
     mStack.back().bindStmt(expr, ObjectV2(0, 0, 8L));
+  } else if (ty->isRecordType()) {
+    // at least its slot count, so MALLOC(sizeof(struct s)) is large enough
+    long size = contextOf(expr).getTypeSizeInChars(ty).getQuantity();
+    mStack.back().bindStmt(expr, ObjectV2(0, 0, size));
   } else {
     llvm::errs() << "unimplemented unaryOrTypeTrait"
                  << "\n";
-    exit(-1);
+    fatal(mStack.back().getPC());
   }
 }
 
@@ -240,9 +605,17 @@ void Environment::decl(DeclStmt *declstmt) {
        it != ie; ++it) {
     Decl *decl = *it;
     if (VarDecl *vardecl = dyn_cast<VarDecl>(decl)) {
+      if (vardecl->isStaticLocal()) {
+        defineStatic(vardecl);
+        continue;
+      }
       auto varDeclType = vardecl->getType();
       Expr *init_expr = vardecl->getInit();
-      if (varDeclType->isConstantArrayType() &&
+      if (long *slot = localSlot(vardecl)) {
+        *slot = init_expr == nullptr
+                    ? 0
+                    : mStack.back().getStmtVal(init_expr).RValue();
+      } else if (varDeclType->isConstantArrayType() &&
           varDeclType->isConstantSizeType()) {
         arrayType(vardecl, init_expr, varDeclType);
       } else if (varDeclType->isIntegerType() || varDeclType->isCharType()) {
@@ -263,13 +636,29 @@ void Environment::decl(DeclStmt *declstmt) {
           v.Assign(init_value);
           mStack.back().bindDecl(vardecl, v);
         }
+      } else if (varDeclType->isRecordType()) {
+        long *ptr;
+        if (init_expr == nullptr) {
+          ptr = newStorage(layout().slots(varDeclType));
+        } else if (isa<InitListExpr>(init_expr)) {
+          ptr = newStorage(layout().slots(varDeclType));
+          initAggregate(ptr, init_expr);
+        } else {
+          // the constructor evaluated to fresh storage
+          ptr = reinterpret_cast<long *>(
+              mStack.back().getStmtVal(init_expr).RValue());
+        }
+        mStack.back().bindDecl(vardecl,
+                               ObjectV2(0, 0, reinterpret_cast<long>(ptr)));
       } else {
         llvm::errs() << "unimplemented vardecl \n";
-        exit(-1);
+        fatal(mStack.back().getPC());
       }
+    } else if (isa<TypeDecl>(decl)) {
+      // e.g. a local struct definition, nothing to run
     } else {
       llvm::errs() << "not vardecl\n";
-      exit(-1);
+      fatal(mStack.back().getPC());
     }
   }
 }
@@ -282,13 +671,24 @@ void Environment::declref(DeclRefExpr *declref) {
       declrefType->isPointerType()) {
     // llvm::dbgs() << declref->getDecl()->getDeclName().getAsString() << '\n';
     Decl *decl = declref->getFoundDecl();
-    auto val = mStack.back().getDeclValRef(mStack, decl);
+    if (const LocalSlot *slot = findLocal(decl)) {
+      long *addr = mActivations.back().Slots + slot->Index;
+      ObjectV2 local(slot->PointerType, 1, reinterpret_cast<long>(addr));
+      mStack.back().bindStmt(declref, local);
+      return;
+    }
+    auto val = mStack.back().getDeclValRef(mStack, linkedDecl(decl));
     mStack.back().bindStmt(declref, val);
+  } else if (declrefType->isRecordType()) {
+    // the variable holds the address of the struct
+    Decl *decl = linkedDecl(declref->getFoundDecl());
+    auto val = mStack.back().getDeclValRef(mStack, decl);
+    mStack.back().bindStmt(declref, val.ToRValue());
   } else {
     llvm::errs() << "unimplement declref type. name: "
                  << declref->getDecl()->getName()
                  << ", classname: " << declrefType->getTypeClassName() << '\n';
-    exit(-1);
+    fatal(mStack.back().getPC());
   }
 }
 
@@ -298,78 +698,437 @@ void Environment::paren(ParenExpr *expr) {
   mStack.back().bindStmt(expr, obj);
 }
 
-void Environment::call(CallExpr *callexpr) {
+Stmt *Environment::call(CallExpr *callexpr) {
   mStack.back().setPC(callexpr);
   FunctionDecl *callee = callexpr->getDirectCallee();
-  if (callee == mInput) {
-    long val;
-    llvm::errs() << "Please Input an Integer Value : ";
-    scanf("%ld", &val);
+  const Environment &shared = this->shared();
+  auto builtin = shared.mBuiltins.find(callee);
+  if (builtin != shared.mBuiltins.end()) {
+    mStack.back().bindStmt(callexpr, builtin->second(*this, callexpr));
+    return nullptr;
+  }
+  auto function = shared.mFunctions.find(functionKey(callee));
+  if (function == shared.mFunctions.end()) {
+    llvm::errs() << "undefined function " << callee->getName() << '\n';
+    fatal(callexpr);
+  }
+  const FunctionInfo &info = function->second;
+  if (!info.Prepared) {
+    // a parallel loop prepares everything it calls before its workers start
+    assert(mParent == nullptr);
+    prepare(mFunctions[function->first], function->first);
+  }
+  if (mParent == nullptr) {
+    ++info.Calls;
+  }
+  if (mPerf != nullptr) {
+    chargeCounters();
+  }
+  callee = info.Definition;
+  //  call user-defined function
+  if (callee->getNumParams() != callexpr->getNumArgs()) {
+    llvm::errs() << "expected " << callee->getNumParams() << "args, actual "
+                 << callexpr->getNumArgs() << '\n';
+    fatal(mStack.back().getPC());
+  }
+  if (!mActivations.empty()) {
+    Activation &caller = mActivations.back();
+    auto site = caller.Function->Inlined.find(callexpr);
+    if (site != caller.Function->Inlined.end()) {
+      // no frame: the parameters go straight to the callee's window of the
+      // caller's slots
+      if (mParent == nullptr) {
+        ++site->second.Calls;
+      }
+      long *slots = caller.Slots + site->second.SlotBase;
+      for (unsigned i = 0, n = callee->getNumParams(); i < n; ++i) {
+        const LocalSlot *slot = info.Locals.find(callee->getParamDecl(i));
+        slots[slot->Index] =
+            mStack.back().getStmtVal(callexpr->getArg(i)).RValue();
+      }
+      mActivations.push_back(Activation{&info, slots, callexpr});
+      return callee->getBody();
+    }
+  }
+  // prepare StackFrame
+  StackFrame stack_frame(0);
+  // the arguments are still read from the caller's frame
+  enterActivation(info, callexpr);
+  for (unsigned i = 0, n = callee->getNumParams(); i < n; ++i) {
+    long arg = mStack.back().getStmtVal(callexpr->getArg(i)).RValue();
+    ParmVarDecl *param = callee->getParamDecl(i);
+    if (long *slot = localSlot(param)) {
+      *slot = arg;
+      continue;
+    }
+    ObjectV2 v(info.ParamPointerTypes[i], 0, arg);
+    stack_frame.bindDecl(param, v);
+    // llvm::dbgs() << "ID=" << callee->getParamDecl(i)->getID() << ", ";
+    // llvm::dbgs() << v.ToString() << ", ";
+  }
+  mStack.push_back(std::move(stack_frame));
+  framePushed();
+  // llvm::dbgs() << "call begin " << callee->getName() << mStack.size()
+  //             << "{\n";
+  return callee->getBody();
+}
+
+void Environment::prepare(FunctionInfo &info, FunctionDecl *callee) {
+  auto start = std::chrono::steady_clock::now();
+  info.Definition = callee->getDefinition();
+  if (info.Definition == nullptr) {
+    llvm::errs() << "undefined function " << callee->getName() << '\n';
+    fatal(mStack.back().getPC());
+  }
+  for (ParmVarDecl *param : info.Definition->parameters()) {
+    info.ParamPointerTypes.push_back(getPointerType(param->getType()));
+  }
+  // running it then only reads the layout
+  warmLayouts(info.Definition, mLayout, info.Definition->getASTContext());
+  info.Locals = LocalSlots::analyze(info.Definition);
+  info.Handlers = HandlerTable::build(info.Definition, mLayout);
+  info.SlotCount = info.Locals.size();
+  if (getLoopOptions().Enabled) {
+    info.Loops =
+        LoopInvariants::analyze(info.Definition, info.Locals, info.SlotCount);
+    info.SlotCount += info.Loops.slots();
+  }
+  info.Prepared = true;
+  inlineCalls(info);
+  info.PrepareSeconds = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+}
+
+void Environment::inlineCalls(FunctionInfo &info) {
+  unsigned threshold = getInlineOptions().Threshold;
+  if (threshold == 0) {
+    return;
+  }
+  for (CallExpr *callexpr : collectCalls(info.Definition)) {
+    FunctionDecl *target = callexpr->getDirectCallee();
+    if (target == nullptr) {
+      continue;
+    }
+    auto function = mFunctions.find(functionKey(target));
+    // builtins are not in mFunctions
+    if (function == mFunctions.end()) {
+      continue;
+    }
+    FunctionDecl *definition = function->first->getDefinition();
+    if (definition == nullptr || definition == mEntry ||
+        countNodes(definition) > threshold || isRecursive(definition)) {
+      continue;
+    }
+    // a callee that cannot reach itself cannot reach this caller either, so
+    // preparing it here terminates
+    FunctionInfo &callee = function->second;
+    if (!callee.Prepared) {
+      prepare(callee, function->first);
+    }
+    bool unboxed = true;
+    for (ParmVarDecl *param : definition->parameters()) {
+      unboxed = unboxed && callee.Locals.find(param) != nullptr;
+    }
+    if (!unboxed) {
+      continue;
+    }
+    info.Inlined[callexpr] = InlineSite{&callee, info.SlotCount, 0};
+    info.SlotCount += callee.SlotCount;
+  }
+}
+
+void Environment::initWorker(const Environment &parent) {
+  mParent = &parent;
+  mEntry = parent.mEntry;
+  mOut = parent.mOut;
+  mStack.emplace_back(StackFrame::kNoFather);
+  mStack.back().inheritVars(parent.mStack.front());
+  // everything in scope at the loop, flattened into one frame
+  mStack.emplace_back(0);
+  for (size_t i = parent.mStack.size() - 1; i != 0;
+       i = parent.mStack[i].father()) {
+    mStack.back().inheritVars(parent.mStack[i]);
+  }
+  const Activation &running = parent.mActivations.back();
+  enterActivation(*running.Function, running.Call);
+  std::copy_n(running.Slots, running.Function->SlotCount,
+              mActivations.back().Slots);
+}
+
+FunctionDecl *Environment::lookupFunction(llvm::StringRef name) const {
+  for (const auto &function : mFunctions) {
+    if (function.first->getName() == name) {
+      return function.first->getDefinition();
+    }
+  }
+  return nullptr;
+}
+
+Stmt *Environment::enter(FunctionDecl *fn, const std::vector<long> &args) {
+  FunctionInfo &info = mFunctions[fn->getCanonicalDecl()];
+  if (!info.Prepared) {
+    prepare(info, fn);
+  }
+  ++info.Calls;
+  if (mPerf != nullptr) {
+    chargeCounters();
+  }
+  assert(args.size() == info.Definition->getNumParams());
+  // a function falling off its end returns 0
+  mRetReg = ObjectV2(0, 0, 0L);
+  StackFrame stack_frame(0);
+  enterActivation(info, nullptr);
+  for (unsigned i = 0, n = args.size(); i < n; ++i) {
+    ParmVarDecl *param = info.Definition->getParamDecl(i);
+    if (long *slot = localSlot(param)) {
+      *slot = args[i];
+      continue;
+    }
+    stack_frame.bindDecl(param,
+                         ObjectV2(info.ParamPointerTypes[i], 0, args[i]));
+  }
+  mStack.push_back(std::move(stack_frame));
+  framePushed();
+  return info.Definition->getBody();
+}
+
+long Environment::leave(size_t frameDepth, size_t activationDepth) {
+  if (mPerf != nullptr) {
+    chargeCounters();
+  }
+  mActivations.resize(activationDepth);
+  popFramesTo(frameDepth);
+  return mRetReg.RValue();
+}
 
-    mStack.back().bindStmt(callexpr, ObjectV2(0, 0, val));
-  } else if (callee == mOutput) {
-    Expr *decl = callexpr->getArg(0);
-    auto val = mStack.back().getStmtVal(decl);
-// #ifndef NDEBUG
-//     llvm::errs().enable_colors(true);
-//     llvm::errs().changeColor(llvm::raw_ostream::Colors::GREEN, true, false);
-// #endif
-    llvm::errs() << val.RValue();
-// #ifndef NDEBUG
-//     llvm::errs().resetColor();
-//     llvm::errs().enable_colors(false);
-// #endif
-  } else if (callee == mMalloc) {
-    Expr *decl = callexpr->getArg(0);
-    auto val = mStack.back().getStmtVal(decl);
-    long n = val.RValue();
-    long *ptr = new long[n];
-    ObjectV2 arr(1, 0, (long)ptr);
-    mHeap.insert(ptr);
-    mStack.back().bindStmt(callexpr, arr);
-  } else if (callee == mFree) {
-    Expr *decl = callexpr->getArg(0);
-    auto val = mStack.back().getStmtVal(decl);
-    long *ptr = reinterpret_cast<long *>(val.RValue());
-    delete[] ptr;
-    int res = mHeap.erase(ptr);
-    assert(res == 1);
+const ParallelLoop &
+Environment::parallelLoop(OMPParallelForDirective *directive) {
+  auto it = mParallelLoops.find(directive);
+  if (it != mParallelLoops.end()) {
+    return it->second;
+  }
+  const ASTContext &context = contextOf(directive);
+  ParallelLoop loop = analyzeParallelFor(directive, context);
+  if (loop.Rejected.empty()) {
+    // a worker runs a nested loop sequentially, and the outer loop prepared
+    // what it calls
+    for (FunctionDecl *callee : loop.Callees) {
+      auto function = mFunctions.find(callee->getCanonicalDecl());
+      if (mParent == nullptr && function != mFunctions.end() &&
+          !function->second.Prepared) {
+        prepare(function->second, callee);
+      }
+    }
   } else {
-    callee = callee->getDefinition();
-    assert(callee->getDefinition() == callee);
-    //  call user-defined function
-    if (callee->getNumParams() != callexpr->getNumArgs()) {
-      llvm::errs() << "expected " << callee->getNumParams() << "args, actual "
-                   << callexpr->getNumArgs() << '\n';
-      exit(-1);
-    }
-    // prepare StackFrame
-    StackFrame stack_frame(0);
-    CallExpr::arg_iterator arg;
-    FunctionDecl::param_iterator param;
-    // llvm::dbgs() << "param: ";
-    for (arg = callexpr->arg_begin(), param = callee->param_begin();
-         arg != callexpr->arg_end() && param != callee->param_end();
-         ++arg, ++param) {
-      auto val = mStack.back().getStmtVal(*arg);
-      unsigned pointerType = getPointerType((*arg)->getType());
-      ObjectV2 v = val.ToRValue();
-      stack_frame.bindDecl(*param, v);
-      // llvm::dbgs() << "ID=" << (*param)->getID() << ", ";
-      // llvm::dbgs() << v.ToString() << ", ";
-    }
-    mStack.push_back(std::move(stack_frame));
-    // llvm::dbgs() << "call begin " << callee->getName() << mStack.size()
-    //             << "{\n";
-    mVisitor->VisitStmt(callee->getBody());
-    mReturned = false;
-    // llvm::dbgs() << "call end" << callee->getName() << mStack.size() << "}\n";
-    // resume PC
-    assert(mRetReg.IsRValue());
-    // llvm::dbgs() << "ret: " << mRetReg.ToString() << '\n';
-    mStack.pop_back();
-    mStack.back().bindStmt(callexpr, mRetReg);
+    llvm::errs() << directive->getBeginLoc().printToString(
+                        context.getSourceManager())
+                 << ": warning: parallel loop runs sequentially, it "
+                 << loop.Rejected << '\n';
+  }
+  return mParallelLoops.emplace(directive, std::move(loop)).first->second;
+}
+
+void Environment::setLoopVar(VarDecl *var, long value) {
+  if (long *slot = localSlot(var)) {
+    *slot = value;
+    return;
+  }
+  mStack.back().bindDecl(var, ObjectV2(0, 0, value));
+}
+
+void Environment::printInlineReport(llvm::raw_ostream &os) const {
+  for (auto &function : mFunctions) {
+    const FunctionInfo &info = function.second;
+    if (info.Inlined.empty()) {
+      continue;
+    }
+    const SourceManager &sm =
+        info.Definition->getASTContext().getSourceManager();
+    for (auto &site : info.Inlined) {
+      os << site.first->getBeginLoc().printToString(sm) << ": inlined "
+         << site.second.Callee->Definition->getName() << " into "
+         << info.Definition->getName() << ", " << site.second.Calls
+         << " calls\n";
+    }
+  }
+}
+
+void Environment::printLoopReport(llvm::raw_ostream &os) const {
+  for (auto &function : mFunctions) {
+    const FunctionInfo &info = function.second;
+    if (info.Loops.plans().empty()) {
+      continue;
+    }
+    const ASTContext &context = info.Definition->getASTContext();
+    const SourceManager &sm = context.getSourceManager();
+    PrintingPolicy policy = context.getPrintingPolicy();
+    for (const LoopPlan &plan : info.Loops.plans()) {
+      os << plan.Loop->getBeginLoc().printToString(sm) << ": loop in "
+         << info.Definition->getName() << ", entered " << plan.Entries
+         << " times\n";
+      for (const HoistedExpr &hoisted : plan.Hoisted) {
+        os << "  hoisted ";
+        hoisted.Expr->printPretty(os, nullptr, policy);
+        os << '\n';
+      }
+      for (const ReducedMul &mul : plan.Reduced) {
+        os << "  reduced ";
+        mul.Expr->printPretty(os, nullptr, policy);
+        os << " to additions\n";
+      }
+    }
+  }
+}
+
+void Environment::printHeapProfile(llvm::raw_ostream &os) const {
+  mHeapProfile->print(os, mUnits);
+}
+
+void Environment::chargeCounters() {
+  PerfSample now = mPerf->read();
+  if (!mActivations.empty()) {
+    mActivations.back().Function->Counters += now - mPerfMark;
+  }
+  mPerfMark = now;
+}
+
+void Environment::printFunctionStats(llvm::raw_ostream &os) const {
+  std::vector<const FunctionInfo *> prepared;
+  for (auto &function : mFunctions) {
+    if (function.second.Prepared) {
+      prepared.push_back(&function.second);
+    }
+  }
+  std::sort(prepared.begin(), prepared.end(),
+            [](const FunctionInfo *a, const FunctionInfo *b) {
+              return a->PrepareSeconds > b->PrepareSeconds;
+            });
+  os << "prepared " << prepared.size() << " of " << mFunctions.size()
+     << " functions\n";
+  bool counters = mPerf != nullptr && mPerf->available();
+  os << "function                      calls  prepare(us)";
+  os << (counters ? "    self cycles  self instrs\n" : "\n");
+  for (const FunctionInfo *info : prepared) {
+    os << llvm::format("%-24s %10u %12.1f",
+                       info->Definition->getNameAsString().c_str(),
+                       info->Calls, info->PrepareSeconds * 1e6);
+    if (counters) {
+      os << llvm::format(" %14lu %12lu", info->Counters.Cycles,
+                         info->Counters.Instructions);
+    }
+    os << '\n';
+  }
+}
+
+void Environment::enterActivation(const FunctionInfo &info, CallExpr *call) {
+  size_t depth = mActivations.size();
+  if (mSlotPool.size() == depth) {
+    mSlotPool.emplace_back();
   }
+  // the array of this depth belongs to a call that has returned, so it may
+  // move when it grows
+  std::vector<long> &slots = mSlotPool[depth];
+  if (slots.size() < info.SlotCount) {
+    slots.resize(info.SlotCount);
+  }
+  mActivations.push_back(Activation{&info, slots.data(), call});
+}
+
+const LocalSlot *Environment::findLocal(Decl *decl) const {
+  if (mActivations.empty()) {
+    return nullptr;
+  }
+  return mActivations.back().Function->Locals.find(dyn_cast<VarDecl>(decl));
+}
+
+long *Environment::localSlot(Decl *decl) {
+  const LocalSlot *slot = findLocal(decl);
+  return slot == nullptr ? nullptr : mActivations.back().Slots + slot->Index;
+}
+
+void Environment::callReturn(CallExpr *callexpr, size_t frameDepth) {
+  if (mPerf != nullptr) {
+    chargeCounters();
+  }
+  mActivations.pop_back();
+  // llvm::dbgs() << "call end" << mStack.size() << "}\n";
+  // resume PC
+  assert(mRetReg.IsRValue());
+  // llvm::dbgs() << "ret: " << mRetReg.ToString() << '\n';
+  if (callexpr->getType()->isRecordType()) {
+    // a returned struct lives in a frame about to be popped
+    unsigned slots = layout().slots(callexpr->getType());
+    long *ptr = allocSlots(slots);
+    long *src = reinterpret_cast<long *>(mRetReg.RValue());
+    checkHeapRange(src, slots);
+    std::copy_n(src, slots, ptr);
+    popFramesTo(frameDepth);
+    mStack.back().setPC(callexpr);
+    mStack.back().mArrs.insert(ptr);
+    mStack.back().bindStmt(callexpr,
+                           ObjectV2(0, 0, reinterpret_cast<long>(ptr)));
+    return;
+  }
+  popFramesTo(frameDepth);
+  // an inlined call pushed no frame, so the callee's body left its last
+  // statement as the PC of the caller's
+  mStack.back().setPC(callexpr);
+  mStack.back().bindStmt(callexpr, mRetReg);
+}
+
+ObjectV2 Environment::getArg(CallExpr *callexpr, unsigned index) const {
+  return mStack.back().getStmtVal(callexpr->getArg(index));
+}
+
+long *Environment::heapAlloc(long n, CallExpr *site) {
+  long *ptr = gShadowHeap != nullptr ? gShadowHeap->alloc(n) : allocSlots(n);
+  if (mHeapProfile != nullptr) {
+    HeapProfile::CallStack stack{site};
+    for (size_t i = mActivations.size();
+         i-- > 0 && stack.size() < HeapProfile::kMaxDepth;) {
+      if (mActivations[i].Call != nullptr) {
+        stack.push_back(mActivations[i].Call);
+      }
+    }
+    mHeapProfile->allocated(stack, ptr, n * sizeof(long));
+  }
+  mHeap.insert(ptr);
+  mHeapSlots += n;
+  mPeakHeapSlots = std::max(mPeakHeapSlots, mHeapSlots);
+  return ptr;
+}
+
+void Environment::heapFree(long *ptr) {
+  if (mHeapProfile != nullptr) {
+    mHeapProfile->freed(ptr);
+  }
+  if (gShadowHeap != nullptr) {
+    // checked before the block is touched
+    gShadowHeap->free(ptr);
+    mHeap.erase(ptr);
+    mHeapSlots -= slotCount(ptr);
+    return;
+  }
+  int res = mHeap.erase(ptr);
+  assert(res == 1);
+  mHeapSlots -= slotCount(ptr);
+  freeSlots(ptr);
+}
+
+bool Environment::readInput(long &val) {
+  if (!mAsyncInput) {
+    scanf("%ld", &val);
+    return true;
+  }
+  if (mInput.empty()) {
+    mWaitingInput = true;
+    return false;
+  }
+  val = mInput.front();
+  mInput.pop_front();
+  mWaitingInput = false;
+  return true;
 }
 
 void Environment::implicitCast(ImplicitCastExpr *expr) {
@@ -380,6 +1139,79 @@ void Environment::implicitCast(ImplicitCastExpr *expr) {
   mStack.back().bindStmt(expr, obj);
 }
 
+bool Environment::loadLocal(ImplicitCastExpr *expr) {
+  if (expr->getCastKind() != CK_LValueToRValue) {
+    return false;
+  }
+  DeclRefExpr *ref = dyn_cast<DeclRefExpr>(expr->getSubExpr()->IgnoreParens());
+  if (ref == nullptr) {
+    return false;
+  }
+  const LocalSlot *slot = findLocal(ref->getFoundDecl());
+  if (slot == nullptr) {
+    return false;
+  }
+  long value = mActivations.back().Slots[slot->Index];
+  mStack.back().setPC(expr);
+  mStack.back().bindStmt(expr, ObjectV2(slot->PointerType, 0, value));
+  return true;
+}
+
+bool Environment::loadLoopValue(BinaryOperator *bop) {
+  if (mActivations.empty()) {
+    return false;
+  }
+  const Activation &running = mActivations.back();
+  const LocalSlot *slot = running.Function->Loops.value(bop);
+  if (slot == nullptr) {
+    return false;
+  }
+  mStack.back().setPC(bop);
+  mStack.back().bindStmt(
+      bop, ObjectV2(slot->PointerType, 0, running.Slots[slot->Index]));
+  return true;
+}
+
+void Environment::enterLoop(Stmt *loop) {
+  if (mActivations.empty()) {
+    return;
+  }
+  const LoopPlan *plan = mActivations.back().Function->Loops.plan(loop);
+  if (plan == nullptr) {
+    return;
+  }
+  if (mParent == nullptr) {
+    ++plan->Entries;
+  }
+  const FunctionInfo &info = *mActivations.back().Function;
+  long *slots = mActivations.back().Slots;
+  for (const HoistedExpr &hoisted : plan->Hoisted) {
+    slots[hoisted.Value.Index] =
+        evalInvariant(hoisted.Expr, info.Locals, info.Handlers, slots);
+  }
+  for (const ReducedMul &mul : plan->Reduced) {
+    slots[mul.Product] =
+        evalInvariant(mul.Expr, info.Locals, info.Handlers, slots);
+    long factor = evalInvariant(mul.Factor, info.Locals, info.Handlers, slots);
+    for (auto &delta : mul.Deltas) {
+      slots[delta.second] = delta.first * factor;
+    }
+  }
+}
+
+void Environment::stepInductions(Stmt *update) {
+  if (mActivations.empty()) {
+    return;
+  }
+  const Activation &running = mActivations.back();
+  if (const std::vector<InductionStep> *steps =
+          running.Function->Loops.steps(update)) {
+    for (const InductionStep &step : *steps) {
+      running.Slots[step.Product] += running.Slots[step.Delta];
+    }
+  }
+}
+
 void Environment::cast(CastExpr *expr) {
   mStack.back().setPC(expr);
   unsigned pointerType = getPointerType(expr->getType());
@@ -393,13 +1225,81 @@ void Environment::arraySubscript(ArraySubscriptExpr *arrSubExpr) {
   auto idx = mStack.back().getStmtVal(arrSubExpr->getIdx());
   Expr *baseExpr = arrSubExpr->getBase();
   auto arr = mStack.back().getStmtVal(baseExpr);
-  mStack.back().bindStmt(arrSubExpr, arr.Subscript(idx));
+  mStack.back().bindStmt(arrSubExpr, handler(arrSubExpr)(arr, idx));
+}
+
+void Environment::member(MemberExpr *expr) {
+  mStack.back().setPC(expr);
+  FieldDecl *decl = dyn_cast<FieldDecl>(expr->getMemberDecl());
+  if (decl == nullptr) {
+    llvm::errs() << "unimplemented member " << expr->getMemberDecl()->getName()
+                 << '\n';
+    fatal(mStack.back().getPC());
+  }
+  const SlotLayout::Field &field = layout().field(decl);
+  // s.f and p->f both evaluate the base to the address of the struct
+  long addr = mStack.back().getStmtVal(expr->getBase()).RValue() +
+              field.Offset * sizeof(long);
+  if (field.Aggregate) {
+    mStack.back().bindStmt(expr, ObjectV2(0, 0, addr));
+  } else {
+    mStack.back().bindStmt(expr, ObjectV2(field.PointerType, 1, addr));
+  }
+}
+
+void Environment::construct(CXXConstructExpr *expr) {
+  mStack.back().setPC(expr);
+  if (!expr->getConstructor()->isTrivial()) {
+    llvm::errs() << "unimplemented constructor\n";
+    fatal(mStack.back().getPC());
+  }
+  unsigned slots = layout().slots(expr->getType());
+  long *ptr = newStorage(slots);
+  if (expr->getNumArgs() == 1) {
+    // a copy or move
+    long *src = reinterpret_cast<long *>(
+        mStack.back().getStmtVal(expr->getArg(0)).RValue());
+    checkHeapRange(src, slots);
+    std::copy_n(src, slots, ptr);
+  }
+  mStack.back().bindStmt(expr, ObjectV2(0, 0, reinterpret_cast<long>(ptr)));
+}
+
+void Environment::operatorCall(CXXOperatorCallExpr *expr) {
+  mStack.back().setPC(expr);
+  FunctionDecl *callee = expr->getDirectCallee();
+  if (expr->getOperator() != OO_Equal || callee == nullptr ||
+      !callee->isTrivial()) {
+    llvm::errs() << "unimplemented operator call\n";
+    fatal(mStack.back().getPC());
+  }
+  ObjectV2 dst = mStack.back().getStmtVal(expr->getArg(0));
+  ObjectV2 src = mStack.back().getStmtVal(expr->getArg(1));
+  long *from = reinterpret_cast<long *>(src.RValue());
+  long *to = reinterpret_cast<long *>(dst.RValue());
+  unsigned slots = layout().slots(expr->getArg(0)->getType());
+  checkHeapRange(from, slots);
+  checkHeapRange(to, slots);
+  std::copy_n(from, slots, to);
+  mStack.back().bindStmt(expr, dst);
+}
+
+void Environment::forward(Expr *expr, Expr *sub) {
+  mStack.back().setPC(expr);
+  mStack.back().bindStmt(expr, mStack.back().getStmtVal(sub));
+}
+
+long *Environment::newStorage(unsigned slots) {
+  long *ptr = allocSlots(slots);
+  mStack.back().mArrs.insert(ptr);
+  return ptr;
 }
 
 void Environment::compoundStmtBegin(CompoundStmt *stmt) {
   mStack.back().setPC(stmt);
   // llvm::dbgs() << "\n{\n";
   mStack.emplace_back((mStack.size() - 1));
+  framePushed();
 }
 
 void Environment::compoundStmtEnd() {
@@ -415,26 +1315,23 @@ void Environment::returnStmt(ReturnStmt *stmt) {
     mRetReg = mStack.back().getStmtVal(e).ToRValue();
     // llvm::dbgs() << "ret value: " << mRetReg.ToString() << '\n';
   }
-  mReturned = true;
 }
 
 void Environment::arrayType(VarDecl *vardecl, Expr *init_expr,
                             clang::QualType tp) {
   auto array_tp = dyn_cast<ConstantArrayType>(tp);
   unsigned pointerType = getPointerType(array_tp->getElementType());
-  if (init_expr == nullptr) {
-    size_t size = array_tp->getSize().getZExtValue();
-    long *ptr = new long[size];
-    mStack.back().bindDecl(
-        vardecl, ObjectV2(pointerType, 0, reinterpret_cast<long>(ptr)));
-    mStack.back().mArrs.insert(ptr);
-  } else {
-    llvm::errs() << "unimplement array initialization.\n";
-    exit(-1);
+  long *ptr = newStorage(layout().slots(tp));
+  mStack.back().bindDecl(
+      vardecl, ObjectV2(pointerType, 0, reinterpret_cast<long>(ptr)));
+  if (init_expr != nullptr) {
+    // its elements were evaluated like any other expression
+    initAggregate(ptr, init_expr);
   }
 }
 
 void Environment::AddScopeBeforeCompoundStmt() {
   // llvm::dbgs() << "{\n";
   mStack.emplace_back(mStack.size() - 1);
+  framePushed();
 }
\ No newline at end of file
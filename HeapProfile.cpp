@@ -0,0 +1,106 @@
+#include "HeapProfile.h"
+#include "Trace.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/AST/Expr.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+
+using namespace clang;
+
+void HeapProfile::allocated(const CallStack &stack, const long *ptr,
+                            size_t bytes) {
+  auto id = mSiteIds.emplace(stack, mSites.size());
+  if (id.second) {
+    // held nothing at any peak so far
+    mSites.push_back(Site{stack, 0, 0, 0, 0, 0, 0, mPeakGeneration});
+  }
+  Site &site = mSites[id.first->second];
+  touch(site);
+  ++site.Allocs;
+  site.TotalBytes += bytes;
+  site.LiveBytes += bytes;
+  site.PeakBytes = std::max(site.PeakBytes, site.LiveBytes);
+  mBlocks[ptr] = Block{id.first->second, bytes};
+  mLive += bytes;
+  if (mLive >= mPeak) {
+    // every site now holds what it holds at the peak
+    mPeak = mLive;
+    ++mPeakGeneration;
+  }
+}
+
+void HeapProfile::freed(const long *ptr) {
+  auto block = mBlocks.find(ptr);
+  if (block == mBlocks.end()) {
+    return;
+  }
+  Site &site = mSites[block->second.Site];
+  touch(site);
+  ++site.Frees;
+  site.LiveBytes -= block->second.Bytes;
+  mLive -= block->second.Bytes;
+  mBlocks.erase(block);
+}
+
+static void printStack(llvm::raw_ostream &os,
+                       const HeapProfile::CallStack &stack,
+                       const std::vector<const ASTContext *> &units) {
+  for (size_t i = 0; i < stack.size(); ++i) {
+    os << (i == 0 ? "    MALLOC at " : "    called from ");
+    if (stack[i] == nullptr) {
+      os << "outside the program\n";
+      continue;
+    }
+    os << stack[i]->getBeginLoc().printToString(
+        unitOf(units, stack[i]).getSourceManager());
+    if (i != 0) {
+      if (const FunctionDecl *callee = stack[i]->getDirectCallee()) {
+        os << " calling " << callee->getName();
+      }
+    }
+    os << '\n';
+  }
+}
+
+void HeapProfile::print(llvm::raw_ostream &os,
+                        const std::vector<const ASTContext *> &units) const {
+  std::vector<const Site *> sites;
+  for (const Site &site : mSites) {
+    sites.push_back(&site);
+  }
+  std::sort(sites.begin(), sites.end(), [](const Site *a, const Site *b) {
+    return a->PeakBytes > b->PeakBytes;
+  });
+  os << "heap profile: peak " << mPeak << " bytes, " << mSites.size()
+     << " allocation sites\n";
+  for (const Site *site : sites) {
+    os << "  " << site->Allocs << " allocs, " << site->Frees << " frees, "
+       << site->TotalBytes << " bytes, peak " << site->PeakBytes
+       << " live, " << bytesAtPeak(*site) << " at the heap peak\n";
+    printStack(os, site->Stack, units);
+  }
+
+  // leaks by site, largest first
+  std::vector<std::pair<size_t, unsigned long>> leaks(mSites.size());
+  for (const auto &block : mBlocks) {
+    leaks[block.second.Site].first += block.second.Bytes;
+    ++leaks[block.second.Site].second;
+  }
+  std::vector<unsigned> order;
+  for (unsigned i = 0; i < leaks.size(); ++i) {
+    if (leaks[i].second != 0) {
+      order.push_back(i);
+    }
+  }
+  std::sort(order.begin(), order.end(), [&leaks](unsigned a, unsigned b) {
+    return leaks[a].first > leaks[b].first;
+  });
+  os << "leaked " << mLive << " bytes in " << mBlocks.size() << " blocks\n";
+  for (unsigned i : order) {
+    os << "  " << leaks[i].first << " bytes in " << leaks[i].second
+       << " blocks\n";
+    printStack(os, mSites[i].Stack, units);
+  }
+}
@@ -0,0 +1,79 @@
+#include "Inlining.h"
+#include "Builtins.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include <unordered_set>
+
+using namespace clang;
+
+static InlineOptions gOptions = {40};
+
+const InlineOptions &getInlineOptions() { return gOptions; }
+
+void setInlineOptions(const InlineOptions &options) { gOptions = options; }
+
+namespace {
+class CallCollector : public RecursiveASTVisitor<CallCollector> {
+public:
+  bool VisitCallExpr(CallExpr *call) {
+    Calls.push_back(call);
+    return true;
+  }
+
+  std::vector<CallExpr *> Calls;
+};
+
+class NodeCounter : public RecursiveASTVisitor<NodeCounter> {
+public:
+  NodeCounter() : Nodes(0) {}
+
+  bool VisitStmt(Stmt *stmt) {
+    ++Nodes;
+    return true;
+  }
+
+  unsigned Nodes;
+};
+} // namespace
+
+std::vector<CallExpr *> collectCalls(FunctionDecl *function) {
+  CallCollector collector;
+  collector.TraverseStmt(function->getBody());
+  return collector.Calls;
+}
+
+unsigned countNodes(FunctionDecl *function) {
+  NodeCounter counter;
+  counter.TraverseStmt(function->getBody());
+  return counter.Nodes;
+}
+
+bool isRecursive(FunctionDecl *function) {
+  const FunctionDecl *target = function->getCanonicalDecl();
+  std::unordered_set<const FunctionDecl *> visited;
+  std::vector<FunctionDecl *> pending{function};
+  while (!pending.empty()) {
+    FunctionDecl *current = pending.back();
+    pending.pop_back();
+    for (CallExpr *call : collectCalls(current)) {
+      FunctionDecl *callee = call->getDirectCallee();
+      if (callee == nullptr) {
+        continue;
+      }
+      if (callee->getCanonicalDecl() == target) {
+        return true;
+      }
+      FunctionDecl *definition = callee->getDefinition();
+      if (definition == nullptr) {
+        // defined in another translation unit, which may call back
+        if (lookupBuiltin(callee->getName()) == nullptr) {
+          return true;
+        }
+        continue;
+      }
+      if (visited.insert(definition->getCanonicalDecl()).second) {
+        pending.push_back(definition);
+      }
+    }
+  }
+  return false;
+}
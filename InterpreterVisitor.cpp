@@ -1,209 +1,663 @@
 #include "InterpreterVisitor.h"
 #include "Environment.h"
-void InterpreterVisitor::VisitIntegerLiteral(IntegerLiteral *lit) {
-  if (mEnv->mReturned) {
-    return;
+#include "Trace.h"
+#include "clang/AST/ExprCXX.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+
+static bool isLoop(Stmt *stmt) {
+  return isa<WhileStmt>(stmt) || isa<ForStmt>(stmt) || isa<DoStmt>(stmt);
+}
+
+/// The comparison at the root of a branch condition, if there is one
+static BinaryOperator *rootComparison(Expr *cond) {
+  BinaryOperator *bop = dyn_cast<BinaryOperator>(cond->IgnoreParens());
+  if (bop != nullptr && (bop->isRelationalOp() || bop->isEqualityOp())) {
+    return bop;
   }
-  VisitStmt(lit);
-  mEnv->intLiteral(lit);
+  return nullptr;
 }
-void InterpreterVisitor::VisitCharacterLiteral(CharacterLiteral *lit) {
-  if (mEnv->mReturned) {
-    return;
+
+void InterpreterVisitor::Start(Stmt *body) {
+  Begin(body);
+  mStepLimit = mBudget.MaxSteps != 0 ? mNodes + mBudget.MaxSteps : ~0UL;
+  if (mBudget.MaxSeconds > 0) {
+    mDeadline = std::chrono::steady_clock::now() +
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(mBudget.MaxSeconds));
   }
-  VisitStmt(lit);
-  mEnv->charLiteral(lit);
 }
-void InterpreterVisitor::VisitBinaryOperator(BinaryOperator *bop) {
-  if (mEnv->mReturned) {
-    return;
+
+void InterpreterVisitor::Begin(Stmt *body) {
+  // A null statement marks the bottom of this run, so nested runs share the
+  // work stack and a return never unwinds past its own entry.
+  mWork.push_back(Task{nullptr, 0, mEnv->frameDepth()});
+  Push(body);
+  mOutOfBudget = false;
+}
+
+void InterpreterVisitor::setBudget(const ExecutionBudget &budget) {
+  mBudget = budget;
+}
+
+bool InterpreterVisitor::CheckBudget(bool withinSteps) {
+  mClockCountdown = kClockInterval;
+  if (!withinSteps || (mBudget.MaxSeconds > 0 &&
+                       std::chrono::steady_clock::now() > mDeadline)) {
+    mOutOfBudget = true;
+    return false;
   }
-  VisitStmt(bop);
-  mEnv->binop(bop);
+  return true;
 }
-void InterpreterVisitor::VisitUnaryOperator(UnaryOperator *uop) {
-  if (mEnv->mReturned) {
-    return;
+
+bool InterpreterVisitor::ChargeSteps() {
+  unsigned long steps = mNodes - mChargedNodes;
+  mChargedNodes = mNodes;
+  unsigned long left = mSharedSteps->load(std::memory_order_relaxed);
+  do {
+    if (left < steps) {
+      // the other workers stop at their next check
+      mSharedSteps->store(0, std::memory_order_relaxed);
+      return false;
+    }
+  } while (!mSharedSteps->compare_exchange_weak(left, left - steps,
+                                                std::memory_order_relaxed));
+  return true;
+}
+
+void InterpreterVisitor::Abandon() {
+  while (mWork.back().S != nullptr) {
+    mWork.pop_back();
   }
-  VisitStmt(uop);
-  mEnv->unary(uop);
 }
-void InterpreterVisitor::VisitUnaryExprOrTypeTraitExpr(
-    UnaryExprOrTypeTraitExpr *expr) {
-  if (mEnv->mReturned) {
-    return;
+
+RunStatus InterpreterVisitor::Resume() {
+  mPaused = false;
+  while (mWork.back().S != nullptr) {
+    if (gTraceRequested) {
+      gTraceRequested = 0;
+      dumpTrace(llvm::errs());
+    }
+    Step();
+    if (mPaused) {
+      return RunStatus::Suspended;
+    }
+    if (mOutOfBudget) {
+      Abandon();
+      mEnv->popFramesTo(mWork.back().Mark);
+      mWork.pop_back();
+      return RunStatus::BudgetExceeded;
+    }
   }
-  VisitStmt(expr);
-  mEnv->unaryOrTypeTrait(expr);
+  mEnv->popFramesTo(mWork.back().Mark);
+  mWork.pop_back();
+  return RunStatus::Finished;
 }
-void InterpreterVisitor::VisitDeclRefExpr(DeclRefExpr *expr) {
-  if (mEnv->mReturned) {
+
+void InterpreterVisitor::Step() {
+  Task &task = mWork.back();
+  Stmt *stmt = task.S;
+  unsigned step = task.Step;
+  if (step == 0) {
+    ++mNodes;
+  }
+  switch (stmt->getStmtClass()) {
+  case Stmt::CallExprClass:
+    return VisitCallExpr(cast<CallExpr>(stmt), step);
+  case Stmt::CXXOperatorCallExprClass:
+    // the callee is the implicit operator= of a struct, only the operands
+    // are evaluated
+    if (step == 0) {
+      CallExpr *call = cast<CallExpr>(stmt);
+      task.Step = 1;
+      for (unsigned i = call->getNumArgs(); i-- > 0;) {
+        Push(call->getArg(i));
+      }
+      return;
+    }
+    break;
+  case Stmt::BinaryOperatorClass:
+    if (cast<BinaryOperator>(stmt)->isLogicalOp()) {
+      return VisitLogicalOperator(cast<BinaryOperator>(stmt), step);
+    }
+    // hoisted out of a loop, or a running product: already in a slot
+    if (step == 0 && mEnv->loadLoopValue(cast<BinaryOperator>(stmt))) {
+      mWork.pop_back();
+      return;
+    }
+    break;
+  case Stmt::ConditionalOperatorClass:
+    return VisitConditionalOperator(cast<ConditionalOperator>(stmt), step);
+  case Stmt::IfStmtClass:
+    return VisitIfStmt(cast<IfStmt>(stmt), step);
+  case Stmt::WhileStmtClass:
+    return VisitWhileStmt(cast<WhileStmt>(stmt), step);
+  case Stmt::ForStmtClass:
+    return VisitForStmt(cast<ForStmt>(stmt), step);
+  case Stmt::DoStmtClass:
+    return VisitDoStmt(cast<DoStmt>(stmt), step);
+  case Stmt::SwitchStmtClass:
+    return VisitSwitchStmt(cast<SwitchStmt>(stmt), step);
+  case Stmt::OMPParallelForDirectiveClass:
+    return VisitParallelFor(cast<OMPParallelForDirective>(stmt), step);
+  case Stmt::CaseStmtClass:
+  case Stmt::DefaultStmtClass:
+    // labels only matter to the jump table
+    task = Task{cast<SwitchCase>(stmt)->getSubStmt(), 0, 0};
     return;
+  case Stmt::BreakStmtClass:
+    return Jump(false);
+  case Stmt::ContinueStmtClass:
+    return Jump(true);
+  case Stmt::CompoundStmtClass:
+    return VisitCompoundStmt(cast<CompoundStmt>(stmt), step);
+  case Stmt::ReturnStmtClass:
+    return VisitReturnStmt(cast<ReturnStmt>(stmt), step);
+  case Stmt::ImplicitCastExprClass:
+    // a read of an unboxed local needs no lvalue
+    if (step == 0 && mEnv->loadLocal(cast<ImplicitCastExpr>(stmt))) {
+      mWork.pop_back();
+      return;
+    }
+    break;
+  case Stmt::UnaryExprOrTypeTraitExprClass:
+    // the operand of sizeof is not evaluated
+    mWork.pop_back();
+    return Apply(stmt);
+  default:
+    break;
   }
-  VisitStmt(expr);
-  mEnv->declref(expr);
+  // everything else evaluates its children first
+  if (step == 0) {
+    task.Step = 1;
+    if (PushChildren(stmt)) {
+      return;
+    }
+  }
+  mWork.pop_back();
+  Apply(stmt);
 }
 
-void InterpreterVisitor::VisitImplicitCastExpr(ImplicitCastExpr *expr) {
-  if (mEnv->mReturned) {
-    return;
+bool InterpreterVisitor::PushChildren(Stmt *stmt) {
+  size_t first = mWork.size();
+  for (Stmt *child : stmt->children()) {
+    if (child != nullptr) {
+      Push(child);
+    }
   }
-  VisitStmt(expr);
-  mEnv->implicitCast(expr);
+  std::reverse(mWork.begin() + first, mWork.end());
+  return mWork.size() != first;
 }
 
-void InterpreterVisitor::VisitCastExpr(CastExpr *expr) {
-  if (mEnv->mReturned) {
-    return;
+void InterpreterVisitor::Apply(Stmt *stmt) {
+  switch (stmt->getStmtClass()) {
+  case Stmt::IntegerLiteralClass:
+    return mEnv->intLiteral(cast<IntegerLiteral>(stmt));
+  case Stmt::CharacterLiteralClass:
+    return mEnv->charLiteral(cast<CharacterLiteral>(stmt));
+  case Stmt::BinaryOperatorClass:
+  case Stmt::CompoundAssignOperatorClass:
+    return mEnv->binop(cast<BinaryOperator>(stmt));
+  case Stmt::UnaryOperatorClass:
+    return mEnv->unary(cast<UnaryOperator>(stmt));
+  case Stmt::UnaryExprOrTypeTraitExprClass:
+    return mEnv->unaryOrTypeTrait(cast<UnaryExprOrTypeTraitExpr>(stmt));
+  case Stmt::DeclRefExprClass:
+    return mEnv->declref(cast<DeclRefExpr>(stmt));
+  case Stmt::ArraySubscriptExprClass:
+    return mEnv->arraySubscript(cast<ArraySubscriptExpr>(stmt));
+  case Stmt::MemberExprClass:
+    return mEnv->member(cast<MemberExpr>(stmt));
+  case Stmt::CXXConstructExprClass:
+    return mEnv->construct(cast<CXXConstructExpr>(stmt));
+  case Stmt::CXXOperatorCallExprClass:
+    return mEnv->operatorCall(cast<CXXOperatorCallExpr>(stmt));
+  case Stmt::MaterializeTemporaryExprClass: {
+    MaterializeTemporaryExpr *expr = cast<MaterializeTemporaryExpr>(stmt);
+    return mEnv->forward(expr, expr->getSubExpr());
+  }
+  case Stmt::ExprWithCleanupsClass: {
+    ExprWithCleanups *expr = cast<ExprWithCleanups>(stmt);
+    return mEnv->forward(expr, expr->getSubExpr());
+  }
+  case Stmt::ParenExprClass:
+    return mEnv->paren(cast<ParenExpr>(stmt));
+  case Stmt::ImplicitCastExprClass:
+    return mEnv->implicitCast(cast<ImplicitCastExpr>(stmt));
+  case Stmt::DeclStmtClass:
+    return mEnv->decl(cast<DeclStmt>(stmt));
+  default:
+    if (CastExpr *expr = dyn_cast<CastExpr>(stmt)) {
+      return mEnv->cast(expr);
+    }
+    // statements without a meaning of their own, e.g. NullStmt
+    break;
   }
-  VisitStmt(expr);
-  mEnv->cast(expr);
 }
 
-void InterpreterVisitor::VisitArraySubscriptExpr(ArraySubscriptExpr *expr) {
-  if (mEnv->mReturned) {
+void InterpreterVisitor::PushCondition(Expr *cond) {
+  if (BinaryOperator *bop = rootComparison(cond)) {
+    // evaluated all the same, only not as a task of its own
+    ++mNodes;
+    Push(bop->getRHS());
+    Push(bop->getLHS());
     return;
   }
-  VisitStmt(expr);
-  mEnv->arraySubscript(expr);
+  Push(cond);
 }
 
-void InterpreterVisitor::VisitParenExpr(ParenExpr *expr) {
-  if (mEnv->mReturned) {
-    return;
+bool InterpreterVisitor::Test(Expr *cond) {
+  if (BinaryOperator *bop = rootComparison(cond)) {
+    return mEnv->compare(bop);
   }
-  VisitStmt(expr);
-  mEnv->paren(expr);
+  return mEnv->valueOf(cond).RValue() != 0;
 }
 
-void InterpreterVisitor::VisitCallExpr(CallExpr *call) {
-  if (mEnv->mReturned) {
-    return;
+void InterpreterVisitor::PushBody(CompoundStmt *stmt, unsigned first) {
+  Stmt **begin = stmt->body_begin() + first;
+  for (Stmt **it = stmt->body_end(); it != begin;) {
+    Push(*--it);
   }
-  VisitStmt(call);
-  mEnv->call(call);
 }
 
-void InterpreterVisitor::VisitIfStmt(IfStmt *stmt) {
-  if (mEnv->mReturned) {
+void InterpreterVisitor::Jump(bool isContinue) {
+  mWork.pop_back();
+  for (;;) {
+    Stmt *stmt = mWork.back().S;
+    if (stmt == nullptr) {
+      // a worker runs the body of a parallel loop without the loop, so
+      // continuing the loop ends the run of the iteration
+      assert(isContinue && inParallelLoop() &&
+             "break or continue outside a loop");
+      mEnv->popFramesTo(mWork.back().Mark);
+      return;
+    }
+    if (isLoop(stmt) || (!isContinue && isa<SwitchStmt>(stmt))) {
+      break;
+    }
+    mWork.pop_back();
+  }
+  Task &target = mWork.back();
+  mEnv->popFramesTo(target.Mark);
+  if (!isContinue) {
+    mWork.pop_back();
+    mEnv->compoundStmtEnd();
     return;
   }
-  mEnv->AddScopeBeforeCompoundStmt();
-  {
-    Stmt *cond = stmt->getCond();
-    // llvm::dbgs() << "if cond: " << cond->getStmtClassName() << '\n';
-    Visit(cond);
-    if (mEnv->mReturned) {
-      mEnv->compoundStmtEnd();
+  // resume at the condition, or the increment of a for
+  target.Step = isa<ForStmt>(target.S) ? 3 : 1;
+}
+
+void InterpreterVisitor::Unwind() {
+  for (;;) {
+    const Task &task = mWork.back();
+    if (task.S == nullptr) {
       return;
     }
+    if (isa<CallExpr>(task.S) && task.Step == 2) {
+      return;
+    }
+    mWork.pop_back();
   }
-  long pcValue = mEnv->getPCValue();
-  if (pcValue != 0) {
-    Stmt *then = stmt->getThen();
-    // llvm::dbgs() << "then: " << then->getStmtClassName() << '\n';
-    Visit(then);
-  } else if (Stmt *e = stmt->getElse()) {
-    // llvm::dbgs() << "else: " << e->getStmtClassName() << '\n';
-    Visit(e);
-  }
-  mEnv->compoundStmtEnd();
 }
 
-void InterpreterVisitor::VisitWhileStmt(WhileStmt *stmt) {
-  if (mEnv->mReturned) {
+void InterpreterVisitor::VisitCallExpr(CallExpr *call, unsigned step) {
+  switch (step) {
+  case 0:
+    mWork.back().Step = 1;
+    PushChildren(call);
     return;
-  }
-  mEnv->AddScopeBeforeCompoundStmt();
-  for (;;) {
-    {
-      auto cond = stmt->getCond();
-      // llvm::dbgs() << "while cond: " << cond->getStmtClassName() << '\n';
-      Visit(cond);
-      if (mEnv->mReturned) {
-        mEnv->compoundStmtEnd();
+  case 1: {
+    if (!WithinBudget()) {
+      return;
+    }
+    size_t depth = mEnv->frameDepth();
+    Stmt *body = mEnv->call(call);
+    if (body == nullptr) {
+      if (mEnv->waitingForInput()) {
+        // GET found no input; it is called again on Resume
+        mPaused = true;
         return;
       }
-      long pcValue = mEnv->getPCValue();
-      if (pcValue == 0) {
-        break;
-      }
+      // builtins finish right away
+      mWork.pop_back();
+      return;
     }
+    mWork.back().Step = 2;
+    mWork.back().Mark = depth;
+    Push(body);
+    return;
+  }
+  default: {
+    size_t depth = mWork.back().Mark;
+    mWork.pop_back();
+    mEnv->callReturn(call, depth);
+    return;
+  }
+  }
+}
 
-    if (Stmt *body = stmt->getBody()) {
-      // llvm::dbgs() << "while body: " << body->getStmtClassName() << '\n';
-      Visit(body);
-      if (mEnv->mReturned) {
-        mEnv->compoundStmtEnd();
-        return;
-      }
+void InterpreterVisitor::VisitLogicalOperator(BinaryOperator *bop,
+                                              unsigned step) {
+  switch (step) {
+  case 0:
+    mWork.back().Step = 1;
+    Push(bop->getLHS());
+    return;
+  case 1: {
+    bool lhs = mEnv->valueOf(bop->getLHS()).RValue() != 0;
+    // the RHS is evaluated only when the LHS does not decide the result
+    if (lhs == (bop->getOpcode() == BO_LAnd)) {
+      mWork.back().Step = 2;
+      Push(bop->getRHS());
+      return;
     }
+    mWork.pop_back();
+    mEnv->logical(bop, lhs);
+    return;
+  }
+  default: {
+    bool rhs = mEnv->valueOf(bop->getRHS()).RValue() != 0;
+    mWork.pop_back();
+    mEnv->logical(bop, rhs);
+    return;
+  }
   }
-  mEnv->compoundStmtEnd();
 }
 
-void InterpreterVisitor::VisitForStmt(ForStmt *stmt) {
-  if (mEnv->mReturned) {
+void InterpreterVisitor::VisitConditionalOperator(ConditionalOperator *expr,
+                                                  unsigned step) {
+  switch (step) {
+  case 0:
+    mWork.back().Step = 1;
+    Push(expr->getCond());
+    return;
+  case 1: {
+    // only the selected arm is evaluated
+    bool cond = mEnv->valueOf(expr->getCond()).RValue() != 0;
+    mWork.back().Step = 2;
+    mWork.back().Mark = cond;
+    Push(cond ? expr->getTrueExpr() : expr->getFalseExpr());
     return;
   }
-  mEnv->AddScopeBeforeCompoundStmt();
-  if (Stmt *s = stmt->getInit()) {
-    // llvm::dbgs() << "for init: " << s->getStmtClassName() << '\n';
-    Visit(s);
-    if (mEnv->mReturned) {
-      mEnv->compoundStmtEnd();
+  default: {
+    bool cond = mWork.back().Mark != 0;
+    mWork.pop_back();
+    mEnv->conditional(expr, cond ? expr->getTrueExpr() : expr->getFalseExpr());
+    return;
+  }
+  }
+}
+
+void InterpreterVisitor::VisitIfStmt(IfStmt *stmt, unsigned step) {
+  switch (step) {
+  case 0:
+    mEnv->AddScopeBeforeCompoundStmt();
+    mWork.back().Step = 1;
+    PushCondition(stmt->getCond());
+    return;
+  case 1: {
+    Stmt *branch = Test(stmt->getCond()) ? stmt->getThen() : stmt->getElse();
+    if (branch != nullptr) {
+      mWork.back().Step = 2;
+      Push(branch);
       return;
     }
+    break;
+  }
+  default:
+    break;
   }
-  while (!mEnv->mReturned) {
-    if (Stmt *condS = (stmt->getCond())) {
-      // llvm::dbgs() << "for cond: " << condS->getStmtClassName() << '\n';
-      Visit(condS);
-      if (mEnv->mReturned) {
-        break;
+  mWork.pop_back();
+  mEnv->compoundStmtEnd();
+}
+
+void InterpreterVisitor::VisitWhileStmt(WhileStmt *stmt, unsigned step) {
+  switch (step) {
+  case 0:
+    mEnv->AddScopeBeforeCompoundStmt();
+    mWork.back().Mark = mEnv->frameDepth();
+    mEnv->enterLoop(stmt);
+    // fall through
+  case 1:
+    mWork.back().Step = 2;
+    PushCondition(stmt->getCond());
+    return;
+  default:
+    if (Test(stmt->getCond())) {
+      if (!WithinBudget()) {
+        return;
       }
-      long pcValue = mEnv->getPCValue();
-      if (pcValue == 0) {
-        break;
+      mWork.back().Step = 1;
+      if (Stmt *body = stmt->getBody()) {
+        Push(body);
       }
+      return;
     }
-    if (Stmt *body = stmt->getBody()) {
-      // llvm::dbgs() << "for body: " << body->getStmtClassName() << '\n';
-      Visit(body);
-      if (mEnv->mReturned) {
-        break;
-      }
+    break;
+  }
+  mWork.pop_back();
+  mEnv->compoundStmtEnd();
+}
+
+void InterpreterVisitor::VisitForStmt(ForStmt *stmt, unsigned step) {
+  // steps: 0 init, 4 entry, 1 cond, 2 test, 3 inc
+  Task &task = mWork.back();
+  switch (step) {
+  case 0:
+    mEnv->AddScopeBeforeCompoundStmt();
+    task.Mark = mEnv->frameDepth();
+    task.Step = 4;
+    if (Stmt *init = stmt->getInit()) {
+      Push(init);
+      return;
+    }
+    // fall through
+  case 4:
+    // what the loop hoists may read what the init wrote
+    mEnv->enterLoop(stmt);
+    // fall through
+  case 1:
+    if (Expr *cond = stmt->getCond()) {
+      task.Step = 2;
+      PushCondition(cond);
+      return;
     }
+    break;
+  case 2:
+    if (!Test(stmt->getCond())) {
+      mWork.pop_back();
+      mEnv->compoundStmtEnd();
+      return;
+    }
+    break;
+  default:
+    if (!WithinBudget()) {
+      return;
+    }
+    task.Step = 1;
     if (Stmt *inc = stmt->getInc()) {
-      // llvm::dbgs() << "for inc: " << inc->getStmtClassName() << '\n';
-      Visit(inc);
-      if (mEnv->mReturned) {
-        break;
+      Push(inc);
+    }
+    return;
+  }
+  task.Step = 3;
+  if (Stmt *body = stmt->getBody()) {
+    Push(body);
+  }
+}
+
+void InterpreterVisitor::VisitDoStmt(DoStmt *stmt, unsigned step) {
+  switch (step) {
+  case 0:
+    mEnv->AddScopeBeforeCompoundStmt();
+    mWork.back().Mark = mEnv->frameDepth();
+    mWork.back().Step = 1;
+    Push(stmt->getBody());
+    return;
+  case 1:
+    mWork.back().Step = 2;
+    PushCondition(stmt->getCond());
+    return;
+  default:
+    if (Test(stmt->getCond())) {
+      if (!WithinBudget()) {
+        return;
       }
+      mWork.back().Step = 1;
+      Push(stmt->getBody());
+      return;
     }
+    break;
   }
+  mWork.pop_back();
   mEnv->compoundStmtEnd();
 }
 
-void InterpreterVisitor::VisitDeclStmt(DeclStmt *declstmt) {
-  if (mEnv->mReturned) {
+void InterpreterVisitor::VisitSwitchStmt(SwitchStmt *stmt, unsigned step) {
+  switch (step) {
+  case 0:
+    mEnv->AddScopeBeforeCompoundStmt();
+    mWork.back().Mark = mEnv->frameDepth();
+    mWork.back().Step = 1;
+    Push(stmt->getCond());
+    return;
+  case 1: {
+    auto table = mSwitchTables.find(stmt);
+    if (table == mSwitchTables.end()) {
+      table = mSwitchTables
+                  .emplace(stmt,
+                           SwitchTable::build(stmt, mEnv->contextOf(stmt)))
+                  .first;
+    }
+    long value = mEnv->valueOf(stmt->getCond()).RValue();
+    unsigned target = table->second.lookup(value);
+    if (target == SwitchTable::kNoTarget) {
+      break;
+    }
+    mWork.back().Step = 2;
+    Stmt *body = stmt->getBody();
+    if (CompoundStmt *compound = dyn_cast<CompoundStmt>(body)) {
+      // enter the body as if it had run up to the target
+      mEnv->compoundStmtBegin(compound);
+      mWork.push_back(Task{compound, 1, 0});
+      PushBody(compound, target);
+    } else {
+      Push(body);
+    }
     return;
   }
-  VisitStmt(declstmt);
-  mEnv->decl(declstmt);
+  default:
+    break;
+  }
+  mWork.pop_back();
+  mEnv->compoundStmtEnd();
 }
-void InterpreterVisitor::VisitCompoundStmt(CompoundStmt *stmt) {
-  if (mEnv->mReturned) {
+
+void InterpreterVisitor::VisitCompoundStmt(CompoundStmt *stmt, unsigned step) {
+  if (step == 0) {
+    mEnv->compoundStmtBegin(stmt);
+    mWork.back().Step = 1;
+    PushBody(stmt, 0);
     return;
   }
-  mEnv->compoundStmtBegin(stmt);
-  VisitStmt(stmt);
+  mWork.pop_back();
   mEnv->compoundStmtEnd();
 }
-void InterpreterVisitor::VisitReturnStmt(ReturnStmt *stmt) {
-  if (mEnv->mReturned) {
-    return;
+
+void InterpreterVisitor::VisitReturnStmt(ReturnStmt *stmt, unsigned step) {
+  if (step == 0) {
+    mWork.back().Step = 1;
+    if (PushChildren(stmt)) {
+      return;
+    }
   }
-  VisitStmt(stmt);
   mEnv->returnStmt(stmt);
+  Unwind();
+}
+
+void InterpreterVisitor::VisitParallelFor(OMPParallelForDirective *directive,
+                                          unsigned step) {
+  const ParallelLoop &loop = mEnv->parallelLoop(directive);
+  if (!loop.Rejected.empty() || inParallelLoop() ||
+      getParallelOptions().Threads <= 1) {
+    // an ordinary loop then
+    assert(loop.Loop != nullptr);
+    mWork.back() = Task{loop.Loop, 0, 0};
+    return;
+  }
+  if (step == 0) {
+    // the bounds are evaluated once, before any iteration
+    mWork.back().Step = 1;
+    Push(loop.End);
+    Push(loop.Begin);
+    return;
+  }
+  long begin = mEnv->valueOf(loop.Begin).RValue();
+  long end = mEnv->valueOf(loop.End).RValue();
+  mWork.pop_back();
+  if (loop.Inclusive) {
+    ++end;
+  }
+  if (begin < end) {
+    RunParallel(loop, begin, (end - begin + loop.Step - 1) / loop.Step);
+  }
+}
+
+void InterpreterVisitor::RunParallel(const ParallelLoop &loop, long begin,
+                                     long trips) {
+  WorkerPool &pool = WorkerPool::get();
+  unsigned workers = pool.size();
+  const Environment &parent = *mEnv;
+  // the workers charge their steps to what is left of this run's budget
+  bool limited = mStepLimit != ~0UL;
+  std::atomic<unsigned long> stepsLeft(
+      mStepLimit > mNodes ? mStepLimit - mNodes : 0);
+  std::atomic<unsigned long> nodes(0);
+  std::atomic<bool> exceeded(false);
+  // an error on a worker is raised on this thread once they all finished
+  bool throws = fatalThrows();
+  std::atomic<bool> failed(false);
+  std::mutex errorMutex;
+  std::string error;
+  // a static schedule: worker i runs the i-th of equal consecutive chunks
+  pool.run([&](unsigned index) {
+    long first = trips * index / workers;
+    long last = trips * (index + 1) / workers;
+    if (first == last) {
+      return;
+    }
+    throwOnFatal(throws);
+    Environment env;
+    env.initWorker(parent);
+    InterpreterVisitor visitor(&env);
+    visitor.mBudget = mBudget;
+    visitor.mSharedSteps = limited ? &stepsLeft : nullptr;
+    visitor.mDeadline = mDeadline;
+    try {
+      for (long i = first; i < last && !exceeded && !failed; ++i) {
+        env.setLoopVar(loop.Var, begin + i * loop.Step);
+        visitor.Begin(loop.Loop->getBody());
+        if (visitor.Resume() == RunStatus::BudgetExceeded) {
+          exceeded = true;
+        }
+      }
+    } catch (const FatalError &failure) {
+      std::lock_guard<std::mutex> lock(errorMutex);
+      if (!failed) {
+        error = failure.what();
+        failed = true;
+      }
+    }
+    nodes += visitor.nodesExecuted();
+  });
+  if (failed) {
+    throw FatalError(error);
+  }
+  mNodes += nodes;
+  if (exceeded) {
+    mOutOfBudget = true;
+  }
 }
@@ -0,0 +1,49 @@
+#include "LocalSlots.h"
+#include "SlotLayout.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include <unordered_set>
+#include <vector>
+
+using namespace clang;
+
+namespace {
+class AddressTakenVisitor : public RecursiveASTVisitor<AddressTakenVisitor> {
+public:
+  bool VisitVarDecl(VarDecl *decl) {
+    QualType ty = decl->getType();
+    // arrays and structs are storage already, statics and block-scope
+    // externs live with the globals
+    if ((ty->isIntegerType() || ty->isPointerType()) &&
+        decl->hasLocalStorage()) {
+      Candidates.push_back(decl);
+    }
+    return true;
+  }
+
+  bool VisitUnaryOperator(UnaryOperator *uop) {
+    if (uop->getOpcode() == UO_AddrOf) {
+      Expr *sub = uop->getSubExpr()->IgnoreParens();
+      if (DeclRefExpr *ref = dyn_cast<DeclRefExpr>(sub)) {
+        Taken.insert(ref->getDecl());
+      }
+    }
+    return true;
+  }
+
+  std::vector<VarDecl *> Candidates;
+  std::unordered_set<const ValueDecl *> Taken;
+};
+} // namespace
+
+LocalSlots LocalSlots::analyze(FunctionDecl *function) {
+  AddressTakenVisitor visitor;
+  visitor.TraverseDecl(function);
+  LocalSlots locals;
+  for (VarDecl *decl : visitor.Candidates) {
+    if (visitor.Taken.count(decl) == 0) {
+      unsigned index = locals.mSlots.size();
+      locals.mSlots[decl] = LocalSlot{index, getPointerType(decl->getType())};
+    }
+  }
+  return locals;
+}
@@ -0,0 +1,327 @@
+#include "LoopInvariants.h"
+#include "SlotLayout.h"
+#include "TypedOps.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/AST/StmtOpenMP.h"
+#include <algorithm>
+#include <cassert>
+#include <unordered_set>
+
+using namespace clang;
+
+static LoopOptions gOptions = {true};
+
+const LoopOptions &getLoopOptions() { return gOptions; }
+
+void setLoopOptions(const LoopOptions &options) { gOptions = options; }
+
+/// The local kept in a slot that expr reads, possibly converted to another
+/// integer type, or nullptr
+static const VarDecl *readLocal(Expr *expr, const LocalSlots &locals) {
+  ImplicitCastExpr *conv = dyn_cast<ImplicitCastExpr>(expr->IgnoreParens());
+  while (conv != nullptr && (conv->getCastKind() == CK_IntegralCast ||
+                             conv->getCastKind() == CK_NoOp)) {
+    conv = dyn_cast<ImplicitCastExpr>(conv->getSubExpr()->IgnoreParens());
+  }
+  if (conv == nullptr || conv->getCastKind() != CK_LValueToRValue) {
+    return nullptr;
+  }
+  DeclRefExpr *ref = dyn_cast<DeclRefExpr>(conv->getSubExpr()->IgnoreParens());
+  if (ref == nullptr) {
+    return nullptr;
+  }
+  const VarDecl *var = dyn_cast<VarDecl>(ref->getDecl());
+  return var != nullptr && locals.find(var) != nullptr ? var : nullptr;
+}
+
+static bool integerConstant(Expr *expr, long &value) {
+  IntegerLiteral *lit = dyn_cast<IntegerLiteral>(expr->IgnoreParenImpCasts());
+  if (lit == nullptr) {
+    return false;
+  }
+  value = lit->getValue().getSExtValue();
+  return true;
+}
+
+/// The operators an invariant expression may be made of. None of them can
+/// trap, so computing one in a loop that runs no iteration is harmless.
+static bool isArithmetic(BinaryOperator *bop) {
+  BinaryOperatorKind op = bop->getOpcode();
+  return op == BO_Add || op == BO_Sub || op == BO_Mul;
+}
+
+namespace {
+/// How the statements of a loop write the locals kept in slots
+class LoopWrites : public RecursiveASTVisitor<LoopWrites> {
+public:
+  explicit LoopWrites(const LocalSlots &locals)
+      : Locals(locals), Written(), Steps() {}
+
+  bool VisitVarDecl(VarDecl *decl) {
+    // declared in the loop, so it has a new value every iteration
+    Written.insert(decl);
+    return true;
+  }
+
+  bool VisitUnaryOperator(UnaryOperator *uop) {
+    if (uop->isIncrementDecrementOp()) {
+      if (const VarDecl *var = target(uop->getSubExpr())) {
+        Steps[var].emplace_back(uop, uop->isIncrementOp() ? 1 : -1);
+      }
+    }
+    return true;
+  }
+
+  bool VisitBinaryOperator(BinaryOperator *bop) {
+    if (!bop->isAssignmentOp()) {
+      return true;
+    }
+    if (const VarDecl *var = target(bop->getLHS())) {
+      long step;
+      if (isStep(bop, var, step)) {
+        Steps[var].emplace_back(bop, step);
+      } else {
+        Written.insert(var);
+      }
+    }
+    return true;
+  }
+
+  bool writes(const VarDecl *var) const {
+    return Written.count(var) != 0 || Steps.count(var) != 0;
+  }
+
+  /// Whether the loop changes var only by adding constants to it
+  bool isInduction(const VarDecl *var) const {
+    return var->getType()->isIntegerType() && Written.count(var) == 0 &&
+           Steps.count(var) != 0;
+  }
+
+  const LocalSlots &Locals;
+  /// Written other than by a constant step
+  std::unordered_set<const VarDecl *> Written;
+  /// The updates adding a constant to a local, with the constant
+  std::unordered_map<const VarDecl *, std::vector<std::pair<Stmt *, long>>>
+      Steps;
+
+private:
+  const VarDecl *target(Expr *lhs) const {
+    DeclRefExpr *ref = dyn_cast<DeclRefExpr>(lhs->IgnoreParens());
+    if (ref == nullptr) {
+      return nullptr;
+    }
+    const VarDecl *var = dyn_cast<VarDecl>(ref->getDecl());
+    return var != nullptr && Locals.find(var) != nullptr ? var : nullptr;
+  }
+
+  /// i += c, i -= c, i = i + c, i = c + i or i = i - c
+  bool isStep(BinaryOperator *bop, const VarDecl *var, long &step) const {
+    switch (bop->getOpcode()) {
+    case BO_AddAssign:
+      return integerConstant(bop->getRHS(), step);
+    case BO_SubAssign:
+      if (integerConstant(bop->getRHS(), step)) {
+        step = -step;
+        return true;
+      }
+      return false;
+    case BO_Assign:
+      break;
+    default:
+      return false;
+    }
+    BinaryOperator *rhs =
+        dyn_cast<BinaryOperator>(bop->getRHS()->IgnoreParenImpCasts());
+    if (rhs == nullptr) {
+      return false;
+    }
+    Expr *l = rhs->getLHS();
+    Expr *r = rhs->getRHS();
+    if (rhs->getOpcode() == BO_Add) {
+      return (readLocal(l, Locals) == var && integerConstant(r, step)) ||
+             (readLocal(r, Locals) == var && integerConstant(l, step));
+    }
+    if (rhs->getOpcode() == BO_Sub && readLocal(l, Locals) == var &&
+        integerConstant(r, step)) {
+      step = -step;
+      return true;
+    }
+    return false;
+  }
+};
+
+/// The for and while loops of a function, outermost first
+class LoopCollector : public RecursiveASTVisitor<LoopCollector> {
+public:
+  bool VisitForStmt(ForStmt *stmt) {
+    if (Parallel.count(stmt) == 0) {
+      add(stmt);
+    }
+    return true;
+  }
+
+  bool VisitWhileStmt(WhileStmt *stmt) {
+    add(stmt);
+    return true;
+  }
+
+  bool VisitOMPParallelForDirective(OMPParallelForDirective *directive) {
+    // workers run the body of the loop only, never its entry
+    Stmt *captured = directive->getInnermostCapturedStmt()->getCapturedStmt();
+    if (ForStmt *loop = dyn_cast<ForStmt>(captured->IgnoreContainers())) {
+      Parallel.insert(loop);
+    }
+    return true;
+  }
+
+  std::vector<Stmt *> Loops;
+
+private:
+  void add(Stmt *loop) {
+    if (Seen.insert(loop).second) {
+      Loops.push_back(loop);
+    }
+  }
+
+  std::unordered_set<const Stmt *> Parallel;
+  std::unordered_set<const Stmt *> Seen;
+};
+} // namespace
+
+/// Reads only literals and locals the loop never writes. evalInvariant
+/// below computes such expressions directly, so the two must accept the
+/// same nodes.
+static bool isInvariant(Expr *expr, const LoopWrites &writes) {
+  expr = expr->IgnoreParens();
+  if (isa<IntegerLiteral>(expr) || isa<CharacterLiteral>(expr)) {
+    return true;
+  }
+  if (ImplicitCastExpr *conv = dyn_cast<ImplicitCastExpr>(expr)) {
+    switch (conv->getCastKind()) {
+    case CK_LValueToRValue: {
+      const VarDecl *var = readLocal(conv, writes.Locals);
+      return var != nullptr && !writes.writes(var);
+    }
+    case CK_IntegralCast:
+    case CK_NoOp:
+      return isInvariant(conv->getSubExpr(), writes);
+    default:
+      return false;
+    }
+  }
+  BinaryOperator *bop = dyn_cast<BinaryOperator>(expr);
+  return bop != nullptr && isArithmetic(bop) &&
+         isInvariant(bop->getLHS(), writes) &&
+         isInvariant(bop->getRHS(), writes);
+}
+
+long evalInvariant(const Expr *expr, const LocalSlots &locals,
+                   const HandlerTable &handlers, const long *slots) {
+  expr = expr->IgnoreParens();
+  if (const IntegerLiteral *lit = dyn_cast<IntegerLiteral>(expr)) {
+    return lit->getValue().getSExtValue();
+  }
+  if (const CharacterLiteral *lit = dyn_cast<CharacterLiteral>(expr)) {
+    return lit->getValue();
+  }
+  if (const ImplicitCastExpr *conv = dyn_cast<ImplicitCastExpr>(expr)) {
+    if (conv->getCastKind() == CK_LValueToRValue) {
+      const DeclRefExpr *ref =
+          cast<DeclRefExpr>(conv->getSubExpr()->IgnoreParens());
+      const LocalSlot *slot = locals.find(cast<VarDecl>(ref->getDecl()));
+      assert(slot != nullptr && "invariant reads a local without a slot");
+      return slots[slot->Index];
+    }
+    // integer conversions keep the value
+    return evalInvariant(conv->getSubExpr(), locals, handlers, slots);
+  }
+  const BinaryOperator *bop = cast<BinaryOperator>(expr);
+  ObjectV2 lhs(0, 0, evalInvariant(bop->getLHS(), locals, handlers, slots));
+  ObjectV2 rhs(0, 0, evalInvariant(bop->getRHS(), locals, handlers, slots));
+  return handlers.find(bop)(lhs, rhs).RValue();
+}
+
+/// The statements run on every iteration of loop
+static std::vector<Stmt *> loopRegion(Stmt *loop) {
+  if (ForStmt *stmt = dyn_cast<ForStmt>(loop)) {
+    return {stmt->getConditionVariableDeclStmt(), stmt->getCond(),
+            stmt->getBody(), stmt->getInc()};
+  }
+  WhileStmt *stmt = dyn_cast<WhileStmt>(loop);
+  return {stmt->getConditionVariableDeclStmt(), stmt->getCond(),
+          stmt->getBody()};
+}
+
+LoopInvariants LoopInvariants::analyze(FunctionDecl *function,
+                                       const LocalSlots &locals,
+                                       unsigned firstSlot) {
+  LoopInvariants invariants;
+  LoopCollector collector;
+  collector.TraverseStmt(function->getBody());
+  for (Stmt *loop : collector.Loops) {
+    std::vector<Stmt *> region = loopRegion(loop);
+    LoopWrites writes(locals);
+    for (Stmt *stmt : region) {
+      writes.TraverseStmt(stmt);
+    }
+    LoopPlan plan{loop, {}, {}, 0};
+    // walk the region in source order, stopping at what is claimed
+    std::vector<Stmt *> work(region.rbegin(), region.rend());
+    while (!work.empty()) {
+      Stmt *stmt = work.back();
+      work.pop_back();
+      if (stmt == nullptr || invariants.mValues.count(stmt) != 0 ||
+          isa<UnaryExprOrTypeTraitExpr>(stmt)) {
+        continue;
+      }
+      if (CaseStmt *label = dyn_cast<CaseStmt>(stmt)) {
+        // case values are constants the switch table has folded
+        work.push_back(label->getSubStmt());
+        continue;
+      }
+      BinaryOperator *bop = dyn_cast<BinaryOperator>(stmt);
+      if (bop != nullptr && isArithmetic(bop) && isInvariant(bop, writes)) {
+        LocalSlot value{firstSlot + invariants.mSlots++,
+                        getPointerType(bop->getType())};
+        invariants.mValues[bop] = value;
+        plan.Hoisted.push_back(HoistedExpr{bop, value});
+        continue;
+      }
+      if (bop != nullptr && bop->getOpcode() == BO_Mul) {
+        Expr *operands[] = {bop->getLHS(), bop->getRHS()};
+        const VarDecl *var = nullptr;
+        Expr *factor = nullptr;
+        for (unsigned i = 0; i < 2 && var == nullptr; ++i) {
+          const VarDecl *read = readLocal(operands[i], locals);
+          if (read != nullptr && writes.isInduction(read) &&
+              isInvariant(operands[1 - i], writes)) {
+            var = read;
+            factor = operands[1 - i];
+          }
+        }
+        if (var != nullptr) {
+          ReducedMul mul{bop, factor, firstSlot + invariants.mSlots++, {}};
+          for (auto &step : writes.Steps[var]) {
+            unsigned delta = firstSlot + invariants.mSlots++;
+            mul.Deltas.emplace_back(step.second, delta);
+            invariants.mSteps[step.first].push_back(
+                InductionStep{mul.Product, delta});
+          }
+          invariants.mValues[bop] = LocalSlot{mul.Product, 0};
+          plan.Reduced.push_back(mul);
+          continue;
+        }
+      }
+      size_t first = work.size();
+      for (Stmt *child : stmt->children()) {
+        work.push_back(child);
+      }
+      std::reverse(work.begin() + first, work.end());
+    }
+    if (!plan.Hoisted.empty() || !plan.Reduced.empty()) {
+      invariants.mLoops[loop] = invariants.mPlans.size();
+      invariants.mPlans.push_back(std::move(plan));
+    }
+  }
+  return invariants;
+}
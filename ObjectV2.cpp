@@ -1,15 +1,16 @@
 #include "ObjectV2.h"
+#include "Trace.h"
 #include "llvm/Support/raw_ostream.h"
-#include <cstdlib>
 
 void ObjectV2::Assign(const ObjectV2 &obj) {
   if (pointerType != obj.pointerType) {
     llvm::errs() << "different type: " << pointerType << " " << obj.pointerType
                  << "\n";
-    exit(-1);
+    fatal(gCurrentPC);
   }
   long *addr = &rawValue;
   for (int i = 0; i < derefCount; ++i) {
+    checkHeapAccess(*addr);
     addr = (long *)(*addr);
   }
   *addr = obj.RValue();
@@ -18,7 +19,7 @@ void ObjectV2::Assign(const ObjectV2 &obj) {
 ObjectV2 ObjectV2::Add(const ObjectV2 &obj) const {
   if (pointerType > 0 && obj.pointerType > 0) {
     llvm::errs() << "invalid add\n";
-    exit(-1);
+    fatal(gCurrentPC);
   } else if (obj.pointerType > 0 && pointerType == 0) {
     return obj.Add(*this);
   } else if (pointerType > 0 && obj.pointerType == 0) {
@@ -31,7 +32,7 @@ ObjectV2 ObjectV2::Add(const ObjectV2 &obj) const {
 ObjectV2 ObjectV2::Sub(const ObjectV2 &obj) const {
   if (pointerType > 0 && obj.pointerType > 0) {
     llvm::errs() << "invalid sub\n";
-    exit(-1);
+    fatal(gCurrentPC);
   } else if (obj.pointerType > 0 && pointerType == 0) {
     return obj.Add(*this);
   } else if (pointerType > 0 && obj.pointerType == 0) {
@@ -44,7 +45,7 @@ ObjectV2 ObjectV2::Sub(const ObjectV2 &obj) const {
 ObjectV2 ObjectV2::Mul(const ObjectV2 &obj) const {
   if (pointerType > 0 || obj.pointerType > 0) {
     llvm::errs() << "invalid mul\n";
-    exit(-1);
+    fatal(gCurrentPC);
   }
   return ObjectV2(0, 0, RValue() * obj.RValue());
 }
@@ -52,15 +53,31 @@ ObjectV2 ObjectV2::Mul(const ObjectV2 &obj) const {
 ObjectV2 ObjectV2::Div(const ObjectV2 &obj) const {
   if (pointerType > 0 || obj.pointerType > 0) {
     llvm::errs() << "invalid div\n";
-    exit(-1);
+    fatal(gCurrentPC);
+  }
+  if (obj.RValue() == 0) {
+    llvm::errs() << "division by zero\n";
+    fatal(gCurrentPC);
   }
   return ObjectV2(0, 0, RValue() / obj.RValue());
 }
 
+ObjectV2 ObjectV2::Rem(const ObjectV2 &obj) const {
+  if (pointerType > 0 || obj.pointerType > 0) {
+    llvm::errs() << "invalid rem\n";
+    fatal(gCurrentPC);
+  }
+  if (obj.RValue() == 0) {
+    llvm::errs() << "division by zero\n";
+    fatal(gCurrentPC);
+  }
+  return ObjectV2(0, 0, RValue() % obj.RValue());
+}
+
 ObjectV2 ObjectV2::Minus() const {
   if (pointerType > 0) {
     llvm::errs() << "invalid minus\n";
-    exit(-1);
+    fatal(gCurrentPC);
   }
   return ObjectV2(0, 0, -RValue());
 }
@@ -68,14 +85,14 @@ ObjectV2 ObjectV2::Minus() const {
 ObjectV2 ObjectV2::Gt(const ObjectV2 &obj) const {
   if (pointerType > 0 || obj.pointerType > 0) {
     llvm::errs() << "invalid gt\n";
-    exit(-1);
+    fatal(gCurrentPC);
   }
   return ObjectV2(0, 0, RValue() > obj.RValue());
 }
 ObjectV2 ObjectV2::Ge(const ObjectV2 &obj) const {
   if (pointerType > 0 || obj.pointerType > 0) {
     llvm::errs() << "invalid ge\n";
-    exit(-1);
+    fatal(gCurrentPC);
   }
   return ObjectV2(0, 0, RValue() >= obj.RValue());
 }
@@ -83,14 +100,14 @@ ObjectV2 ObjectV2::Lt(const ObjectV2 &obj) const {
 
   if (pointerType > 0 || obj.pointerType > 0) {
     llvm::errs() << "invalid lt\n";
-    exit(-1);
+    fatal(gCurrentPC);
   }
   return ObjectV2(0, 0, RValue() < obj.RValue());
 }
 ObjectV2 ObjectV2::Le(const ObjectV2 &obj) const {
   if (pointerType > 0 || obj.pointerType > 0) {
     llvm::errs() << "invalid le\n";
-    exit(-1);
+    fatal(gCurrentPC);
   }
   return ObjectV2(0, 0, RValue() <= obj.RValue());
 }
@@ -98,18 +115,34 @@ ObjectV2 ObjectV2::Le(const ObjectV2 &obj) const {
 ObjectV2 ObjectV2::Eq(const ObjectV2 &obj) const {
   if (pointerType > 0 || obj.pointerType > 0) {
     llvm::errs() << "invalid eq\n";
-    exit(-1);
+    fatal(gCurrentPC);
   }
   return ObjectV2(0, 0, RValue() == obj.RValue());
 }
+
+ObjectV2 ObjectV2::Ne(const ObjectV2 &obj) const {
+  if (pointerType > 0 || obj.pointerType > 0) {
+    llvm::errs() << "invalid ne\n";
+    fatal(gCurrentPC);
+  }
+  return ObjectV2(0, 0, RValue() != obj.RValue());
+}
 ObjectV2 ObjectV2::Deref() const {
   if (pointerType == 0) {
     llvm::errs() << "invalid deref\n";
-    exit(-1);
+    fatal(gCurrentPC);
   }
   return ObjectV2(pointerType - 1, derefCount + 1, rawValue);
 }
 
+ObjectV2 ObjectV2::AddressOf() const {
+  if (derefCount == 0) {
+    llvm::errs() << "invalid address-of\n";
+    fatal(gCurrentPC);
+  }
+  return ObjectV2(pointerType + 1, derefCount - 1, rawValue);
+}
+
 ObjectV2 ObjectV2::Subscript(const ObjectV2 &obj) const {
   ObjectV2 ptr = this->Add(obj);
   return ptr.Deref();
@@ -0,0 +1,371 @@
+#include "ParallelFor.h"
+#include "Builtins.h"
+#include "SlotLayout.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/AST/StmtOpenMP.h"
+#include <algorithm>
+#include <unordered_set>
+
+using namespace clang;
+
+static ParallelOptions gOptions = {
+    std::max(1u, std::thread::hardware_concurrency())};
+
+const ParallelOptions &getParallelOptions() { return gOptions; }
+
+void setParallelOptions(const ParallelOptions &options) { gOptions = options; }
+
+static VarDecl *referencedVar(Expr *expr) {
+  if (DeclRefExpr *ref = dyn_cast<DeclRefExpr>(expr->IgnoreParenImpCasts())) {
+    return dyn_cast<VarDecl>(ref->getDecl());
+  }
+  return nullptr;
+}
+
+namespace {
+/// Finds what keeps the iterations of a loop body, or the functions it
+/// calls, from running at the same time
+class IndependenceChecker : public RecursiveASTVisitor<IndependenceChecker> {
+public:
+  IndependenceChecker(VarDecl *var)
+      : Callees(), Rejected(), mVar(var), mCallee(nullptr), mLocals(),
+        mLoops(0), mSwitches(0), mVisited() {}
+
+  void checkBody(Stmt *body) { TraverseStmt(body); }
+
+  void checkCallees() {
+    for (size_t i = 0; i < Callees.size() && Rejected.empty(); ++i) {
+      mCallee = Callees[i];
+      TraverseStmt(mCallee->getBody());
+    }
+  }
+
+  bool TraverseForStmt(ForStmt *stmt) {
+    ++mLoops;
+    bool result = RecursiveASTVisitor::TraverseForStmt(stmt);
+    --mLoops;
+    return result;
+  }
+  bool TraverseWhileStmt(WhileStmt *stmt) {
+    ++mLoops;
+    bool result = RecursiveASTVisitor::TraverseWhileStmt(stmt);
+    --mLoops;
+    return result;
+  }
+  bool TraverseDoStmt(DoStmt *stmt) {
+    ++mLoops;
+    bool result = RecursiveASTVisitor::TraverseDoStmt(stmt);
+    --mLoops;
+    return result;
+  }
+  bool TraverseSwitchStmt(SwitchStmt *stmt) {
+    ++mSwitches;
+    bool result = RecursiveASTVisitor::TraverseSwitchStmt(stmt);
+    --mSwitches;
+    return result;
+  }
+
+  bool VisitVarDecl(VarDecl *decl) {
+    if (decl->isStaticLocal()) {
+      return reject("declares the static variable " + name(decl));
+    }
+    mLocals.insert(decl);
+    return true;
+  }
+
+  bool VisitBinaryOperator(BinaryOperator *bop) {
+    return !bop->isAssignmentOp() || checkWrite(bop->getLHS());
+  }
+
+  bool VisitUnaryOperator(UnaryOperator *uop) {
+    if (uop->isIncrementDecrementOp()) {
+      return checkWrite(uop->getSubExpr());
+    }
+    if (uop->getOpcode() == UO_AddrOf) {
+      // a pointer to a shared scalar could be written through
+      VarDecl *var = referencedVar(uop->getSubExpr());
+      if (var != nullptr && !var->getType()->isArrayType() &&
+          !mayWrite(var)) {
+        return reject("takes the address of " + name(var));
+      }
+    }
+    return true;
+  }
+
+  // a continue of the parallel loop itself just ends the iteration a
+  // worker runs, but a break would skip the iterations of other workers
+  bool VisitBreakStmt(BreakStmt *stmt) {
+    return mCallee != nullptr || mLoops != 0 || mSwitches != 0 ||
+           reject("breaks out of the parallel loop");
+  }
+
+  bool VisitCallExpr(CallExpr *call) {
+    FunctionDecl *callee = call->getDirectCallee();
+    if (callee == nullptr) {
+      return reject("calls through a pointer");
+    }
+    llvm::StringRef callName = callee->getName();
+    // their state lives in the Environment of the interpreter thread
+    if (callName == "PRINT" || callName == "GET" || callName == "MALLOC" ||
+        callName == "FREE") {
+      return reject("calls " + callName.str());
+    }
+    FunctionDecl *definition = callee->getDefinition();
+    if (definition == nullptr && lookupBuiltin(callName) == nullptr) {
+      return reject("calls " + callName.str() +
+                    " from another translation unit");
+    }
+    if (definition != nullptr &&
+        mVisited.insert(definition->getCanonicalDecl()).second) {
+      Callees.push_back(definition);
+    }
+    return true;
+  }
+
+  std::vector<FunctionDecl *> Callees;
+  std::string Rejected;
+
+private:
+  static std::string name(NamedDecl *decl) {
+    return "'" + decl->getName().str() + "'";
+  }
+
+  bool reject(const std::string &reason) {
+    Rejected = (mCallee != nullptr ? name(mCallee) + " " : "") + reason;
+    return false;
+  }
+
+  bool mayWrite(VarDecl *var) const {
+    if (mCallee != nullptr) {
+      return !var->hasGlobalStorage();
+    }
+    return var != mVar && mLocals.count(var) != 0;
+  }
+
+  bool checkWrite(Expr *lhs) {
+    lhs = lhs->IgnoreParenImpCasts();
+    // a field of a struct variable is part of the variable
+    while (MemberExpr *member = dyn_cast<MemberExpr>(lhs)) {
+      if (member->isArrow()) {
+        return true;
+      }
+      lhs = member->getBase()->IgnoreParenImpCasts();
+    }
+    VarDecl *var = referencedVar(lhs);
+    if (var == nullptr || mayWrite(var)) {
+      return true;
+    }
+    if (var == mVar) {
+      return reject("assigns the loop variable");
+    }
+    return reject("writes the shared variable " + name(var));
+  }
+
+  VarDecl *mVar;
+  /// The function being checked, nullptr while in the loop body
+  FunctionDecl *mCallee;
+  /// Declared within the loop body, so private to an iteration
+  std::unordered_set<VarDecl *> mLocals;
+  unsigned mLoops;
+  unsigned mSwitches;
+  std::unordered_set<FunctionDecl *> mVisited;
+};
+
+class LayoutWarmer : public RecursiveASTVisitor<LayoutWarmer> {
+public:
+  LayoutWarmer(SlotLayout &layout, const ASTContext &context)
+      : mLayout(layout), mContext(context) {}
+
+  bool VisitExpr(Expr *expr) {
+    warm(expr->getType());
+    return true;
+  }
+
+  bool VisitValueDecl(ValueDecl *decl) {
+    warm(decl->getType());
+    return true;
+  }
+
+  bool VisitUnaryExprOrTypeTraitExpr(UnaryExprOrTypeTraitExpr *expr) {
+    warm(expr->getTypeOfArgument());
+    return true;
+  }
+
+private:
+  void warm(QualType ty) {
+    if (ty.isNull() || ty->isIncompleteType()) {
+      return;
+    }
+    mLayout.slots(ty);
+    mContext.getAsArrayType(ty);
+    if (ty->isRecordType()) {
+      mContext.getTypeSizeInChars(ty);
+    }
+    if (ty->isPointerType()) {
+      warm(ty->getPointeeType());
+    }
+  }
+
+  SlotLayout &mLayout;
+  const ASTContext &mContext;
+};
+} // namespace
+
+/// Reads the init, condition and increment of a canonical loop
+static std::string matchCanonical(ParallelLoop &loop,
+                                  const ASTContext &context) {
+  ForStmt *stmt = loop.Loop;
+  if (DeclStmt *decl = dyn_cast_or_null<DeclStmt>(stmt->getInit())) {
+    if (decl->isSingleDecl()) {
+      loop.Var = dyn_cast<VarDecl>(decl->getSingleDecl());
+      loop.Begin = loop.Var != nullptr ? loop.Var->getInit() : nullptr;
+    }
+  } else if (BinaryOperator *init =
+                 dyn_cast_or_null<BinaryOperator>(stmt->getInit())) {
+    if (init->getOpcode() == BO_Assign) {
+      loop.Var = referencedVar(init->getLHS());
+      loop.Begin = init->getRHS();
+    }
+  }
+  if (loop.Var == nullptr || loop.Begin == nullptr ||
+      !loop.Var->getType()->isIntegerType()) {
+    return "does not start an integer loop variable";
+  }
+  BinaryOperator *cond = dyn_cast_or_null<BinaryOperator>(stmt->getCond());
+  if (cond == nullptr ||
+      (cond->getOpcode() != BO_LT && cond->getOpcode() != BO_LE) ||
+      referencedVar(cond->getLHS()) != loop.Var) {
+    return "does not test the loop variable with < or <=";
+  }
+  loop.End = cond->getRHS();
+  loop.Inclusive = cond->getOpcode() == BO_LE;
+  Expr *inc = stmt->getInc();
+  Expr *step = nullptr;
+  if (UnaryOperator *uop = dyn_cast_or_null<UnaryOperator>(inc)) {
+    if (uop->isIncrementOp() && referencedVar(uop->getSubExpr()) == loop.Var) {
+      loop.Step = 1;
+    }
+  } else if (BinaryOperator *bop = dyn_cast_or_null<BinaryOperator>(inc)) {
+    if (bop->getOpcode() == BO_AddAssign &&
+        referencedVar(bop->getLHS()) == loop.Var) {
+      step = bop->getRHS();
+    } else if (bop->getOpcode() == BO_Assign &&
+               referencedVar(bop->getLHS()) == loop.Var) {
+      // i = i + step
+      BinaryOperator *add =
+          dyn_cast<BinaryOperator>(bop->getRHS()->IgnoreParenImpCasts());
+      if (add != nullptr && add->getOpcode() == BO_Add &&
+          referencedVar(add->getLHS()) == loop.Var) {
+        step = add->getRHS();
+      }
+    }
+  }
+  Expr::EvalResult result;
+  if (step != nullptr && step->EvaluateAsInt(result, context)) {
+    loop.Step = result.Val.getInt().getExtValue();
+  }
+  if (loop.Step <= 0) {
+    return "does not count up by a constant step";
+  }
+  return std::string();
+}
+
+ParallelLoop analyzeParallelFor(OMPParallelForDirective *directive,
+                                const ASTContext &context) {
+  ParallelLoop loop{nullptr, nullptr, nullptr, nullptr, false, 0, {}, {}};
+  Stmt *captured = directive->getInnermostCapturedStmt()->getCapturedStmt();
+  loop.Loop = dyn_cast<ForStmt>(captured->IgnoreContainers());
+  if (loop.Loop == nullptr) {
+    loop.Rejected = "is not a for loop";
+    return loop;
+  }
+  loop.Rejected = matchCanonical(loop, context);
+  if (!loop.Rejected.empty()) {
+    return loop;
+  }
+  IndependenceChecker checker(loop.Var);
+  checker.checkBody(loop.Loop->getBody());
+  if (checker.Rejected.empty()) {
+    checker.checkCallees();
+  }
+  loop.Callees = checker.Callees;
+  loop.Rejected = checker.Rejected;
+  return loop;
+}
+
+void warmLayouts(Decl *decl, SlotLayout &layout, const ASTContext &context) {
+  LayoutWarmer warmer(layout, context);
+  warmer.TraverseDecl(decl);
+}
+
+static thread_local bool tInParallel = false;
+
+bool inParallelLoop() { return tInParallel; }
+
+static void runTask(const std::function<void(unsigned)> &task,
+                    unsigned index) {
+  tInParallel = true;
+  task(index);
+  tInParallel = false;
+}
+
+WorkerPool::WorkerPool(unsigned threads)
+    : mThreads(), mMutex(), mStart(), mDone(), mTask(nullptr),
+      mGeneration(0), mPending(0), mStop(false) {
+  for (unsigned i = 1; i < threads; ++i) {
+    mThreads.emplace_back(&WorkerPool::work, this, i);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStop = true;
+  }
+  mStart.notify_all();
+  for (std::thread &thread : mThreads) {
+    thread.join();
+  }
+}
+
+void WorkerPool::run(const std::function<void(unsigned)> &task) {
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mTask = &task;
+    mPending = mThreads.size();
+    ++mGeneration;
+  }
+  mStart.notify_all();
+  runTask(task, 0);
+  std::unique_lock<std::mutex> lock(mMutex);
+  mDone.wait(lock, [this] { return mPending == 0; });
+  mTask = nullptr;
+}
+
+void WorkerPool::work(unsigned index) {
+  unsigned long seen = 0;
+  for (;;) {
+    const std::function<void(unsigned)> *task;
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mStart.wait(lock, [&] { return mStop || mGeneration != seen; });
+      if (mStop) {
+        return;
+      }
+      seen = mGeneration;
+      task = mTask;
+    }
+    runTask(*task, index);
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (--mPending == 0) {
+      mDone.notify_one();
+    }
+  }
+}
+
+WorkerPool &WorkerPool::get() {
+  // never destroyed: a worker may exit the process on an error
+  static WorkerPool *pool = new WorkerPool(getParallelOptions().Threads);
+  return *pool;
+}
@@ -0,0 +1,69 @@
+#include "PerfCounters.h"
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// in the order of the fields of PerfSample
+static const uint64_t kConfigs[] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_BRANCH_MISSES,
+    PERF_COUNT_HW_CACHE_MISSES,
+};
+
+PerfCounters::PerfCounters() {
+  for (int &fd : mFds) {
+    fd = -1;
+  }
+}
+
+PerfCounters::~PerfCounters() {
+  for (int fd : mFds) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+bool PerfCounters::open() {
+  for (unsigned i = 0; i < kEvents; ++i) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = kConfigs[i];
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // the leader starts disabled and enables the whole group at once
+    attr.disabled = i == 0;
+    int fd = syscall(SYS_perf_event_open, &attr, 0, -1,
+                     i == 0 ? -1 : mFds[0], 0);
+    if (i == 0 && fd < 0) {
+      return false;
+    }
+    // a missing event leaves the others usable
+    mFds[i] = fd;
+  }
+  ioctl(mFds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(mFds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  return true;
+}
+
+PerfSample PerfCounters::read() const {
+  uint64_t counts[kEvents] = {0, 0, 0, 0};
+  if (available()) {
+    // the number of members, then their values in the order they joined
+    uint64_t group[1 + kEvents];
+    if (::read(mFds[0], group, sizeof(group)) > 0) {
+      for (unsigned i = 0, member = 0; i < kEvents; ++i) {
+        if (mFds[i] >= 0 && member < group[0]) {
+          counts[i] = group[1 + member++];
+        }
+      }
+    }
+  }
+  return PerfSample{counts[0], counts[1], counts[2], counts[3]};
+}
@@ -0,0 +1,47 @@
+#include "Program.h"
+#include "clang/AST/Decl.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Tooling/Tooling.h"
+
+std::unique_ptr<Program> Program::load(llvm::StringRef code) {
+  // -fopenmp keeps `#pragma omp parallel for` in the AST
+  std::unique_ptr<ASTUnit> unit =
+      clang::tooling::buildASTFromCodeWithArgs(code, {"-fopenmp"});
+  if (!unit || unit->getDiagnostics().hasErrorOccurred()) {
+    return nullptr;
+  }
+  return std::unique_ptr<Program>(new Program(std::move(unit)));
+}
+
+Program::Program(std::unique_ptr<ASTUnit> unit)
+    : mUnit(std::move(unit)), mEnv(), mVisitor(&mEnv), mFunctions() {
+  mEnv.init(mUnit->getASTContext().getTranslationUnitDecl());
+}
+
+Program::~Program() {}
+
+const Program::Function *Program::lookup(llvm::StringRef name) {
+  auto it = mFunctions.find(name);
+  if (it != mFunctions.end()) {
+    return &it->second;
+  }
+  FunctionDecl *definition = mEnv.lookupFunction(name);
+  if (definition == nullptr) {
+    return nullptr;
+  }
+  // StringMap entries do not move, so the handle stays valid
+  return &(mFunctions[name] = Function{definition, definition->getNumParams()});
+}
+
+RunStatus Program::call(const Function &fn, const std::vector<long> &args,
+                        long &result) {
+  assert(args.size() == fn.Arity);
+  size_t frames = mEnv.frameDepth();
+  size_t activations = mEnv.activationDepth();
+  RunStatus status = mVisitor.Execute(mEnv.enter(fn.Definition, args));
+  long ret = mEnv.leave(frames, activations);
+  if (status == RunStatus::Finished) {
+    result = ret;
+  }
+  return status;
+}
@@ -0,0 +1,166 @@
+#include "Repl.h"
+#include "clang/AST/ASTConsumer.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/Basic/TargetInfo.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/CompilerInvocation.h"
+#include "clang/Lex/Preprocessor.h"
+#include "clang/Parse/Parser.h"
+#include "clang/Sema/Sema.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cctype>
+
+// Clang 10 has no incremental parser, so the session drives the Parser
+// itself. With incremental processing the preprocessor keeps the main file
+// open at its end, each snippet is entered as a file included there, and
+// Parser::ParseTopLevelDecl stops at its end without ending the translation
+// unit.
+
+Repl::Repl() : mCompiler(new CompilerInstance()), mSnippets(0) {
+  CompilerInstance &ci = *mCompiler;
+  ci.createDiagnostics();
+  // the same language as ast-interpreter parses its input in; -fopenmp
+  // keeps `#pragma omp parallel for` in the AST
+  const char *args[] = {"-x", "c++", "-fopenmp"};
+  CompilerInvocation::CreateFromArgs(ci.getInvocation(), args,
+                                     ci.getDiagnostics());
+  ci.setTarget(TargetInfo::CreateTargetInfo(ci.getDiagnostics(),
+                                            ci.getInvocation().TargetOpts));
+  ci.getTarget().adjust(ci.getLangOpts());
+  ci.createFileManager();
+  ci.createSourceManager(ci.getFileManager());
+  ci.createPreprocessor(TU_Prefix);
+  Preprocessor &pp = ci.getPreprocessor();
+  pp.enableIncrementalProcessing();
+  SourceManager &sm = ci.getSourceManager();
+  sm.setMainFileID(
+      sm.createFileID(llvm::MemoryBuffer::getMemBuffer("", "repl.cc")));
+  ci.createASTContext();
+  ci.setASTConsumer(std::make_unique<ASTConsumer>());
+  ci.createSema(TU_Prefix, nullptr);
+  ci.getDiagnosticClient().BeginSourceFile(ci.getLangOpts(), &pp);
+  pp.EnterMainSourceFile();
+  mParser.reset(new Parser(pp, ci.getSema(), /*SkipFunctionBodies=*/false));
+  mParser->Initialize();
+
+  ASTContext &context = ci.getASTContext();
+  mEnv.init(context.getTranslationUnitDecl());
+  mVisitor.reset(new InterpreterVisitor(&mEnv));
+}
+
+Repl::~Repl() {
+  // the parser refers to the Sema of the compiler
+  mParser.reset();
+}
+
+bool Repl::isComplete(llvm::StringRef text) {
+  int depth = 0;
+  char last = 0;
+  for (size_t i = 0; i < text.size(); ++i) {
+    char c = text[i];
+    if (c == '/' && i + 1 < text.size() && text[i + 1] == '/') {
+      i = text.find('\n', i);
+      if (i == llvm::StringRef::npos) {
+        break;
+      }
+      continue;
+    }
+    if (c == '\'' || c == '"') {
+      // skip the literal, escapes included
+      for (++i; i < text.size() && text[i] != c; ++i) {
+        if (text[i] == '\\') {
+          ++i;
+        }
+      }
+    } else if (c == '(' || c == '[' || c == '{') {
+      ++depth;
+    } else if (c == ')' || c == ']' || c == '}') {
+      --depth;
+    }
+    if (!isspace(static_cast<unsigned char>(c))) {
+      last = c;
+    }
+  }
+  return depth <= 0 && (last == ';' || last == '}' || last == 0);
+}
+
+bool Repl::isDeclaration(llvm::StringRef snippet) const {
+  llvm::StringRef word = snippet.ltrim().take_while([](char c) {
+    return isalnum(static_cast<unsigned char>(c)) || c == '_';
+  });
+  if (word.empty()) {
+    return false;
+  }
+  static const char *const kSpecifiers[] = {
+      "char",  "const",    "enum",   "extern",   "inline", "int",
+      "long",  "short",    "signed", "static",   "struct", "typedef",
+      "union", "unsigned", "void",   "volatile",
+  };
+  for (const char *specifier : kSpecifiers) {
+    if (word == specifier) {
+      return true;
+    }
+  }
+  // `point p;` with point a typedef or struct declared before
+  ASTContext &context = mCompiler->getASTContext();
+  for (NamedDecl *decl :
+       context.getTranslationUnitDecl()->lookup(&context.Idents.get(word))) {
+    if (isa<TypeDecl>(decl)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Repl::parse(const std::string &code, std::vector<Decl *> &decls) {
+  SourceManager &sm = mCompiler->getSourceManager();
+  Preprocessor &pp = mCompiler->getPreprocessor();
+  DiagnosticConsumer &diags = mCompiler->getDiagnosticClient();
+  unsigned errors = diags.getNumErrors();
+  std::string name = "input" + std::to_string(mSnippets) + ".cc";
+  FileID file =
+      sm.createFileID(llvm::MemoryBuffer::getMemBufferCopy(code, name));
+  pp.EnterSourceFile(file, nullptr, SourceLocation());
+  // the previous snippet left the parser at its end
+  if (mParser->getCurToken().is(tok::eof)) {
+    mParser->ConsumeToken();
+  }
+  Parser::DeclGroupPtrTy group;
+  while (!mParser->ParseTopLevelDecl(group)) {
+    if (group) {
+      decls.insert(decls.end(), group.get().begin(), group.get().end());
+    }
+  }
+  return diags.getNumErrors() == errors;
+}
+
+bool Repl::eval(llvm::StringRef snippet) {
+  bool statements = !isDeclaration(snippet);
+  std::string code = snippet.str();
+  if (statements) {
+    code = "void __repl_" + std::to_string(mSnippets) + "() {\n" + code +
+           "\n}\n";
+  }
+  std::vector<Decl *> decls;
+  bool parsed = parse(code, decls);
+  ++mSnippets;
+  if (!parsed) {
+    return false;
+  }
+  mEnv.declare(decls);
+  if (statements) {
+    size_t frames = mEnv.frameDepth();
+    size_t activations = mEnv.activationDepth();
+    FunctionDecl *body = cast<FunctionDecl>(decls.back());
+    RunStatus status = mVisitor->Execute(mEnv.enter(body, {}));
+    mEnv.leave(frames, activations);
+    if (status == RunStatus::BudgetExceeded) {
+      mEnv.output().flush();
+      llvm::errs() << "\nexecution budget exceeded\n";
+    }
+  }
+  mEnv.output().flush();
+  return true;
+}
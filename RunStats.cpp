@@ -0,0 +1,118 @@
+#include "RunStats.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+#include <atomic>
+#include <ctime>
+
+static std::atomic<unsigned long> gAllocCalls(0);
+static std::atomic<unsigned long> gAllocBytes(0);
+
+void countHostAlloc(size_t bytes) {
+  gAllocCalls.fetch_add(1, std::memory_order_relaxed);
+  gAllocBytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+HostAllocCount hostAllocCount() {
+  return HostAllocCount{gAllocCalls.load(std::memory_order_relaxed),
+                        gAllocBytes.load(std::memory_order_relaxed)};
+}
+
+static double cpuSeconds() {
+  timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void PhaseTimer::restart() {
+  mWall = std::chrono::steady_clock::now();
+  mCpu = cpuSeconds();
+  mAllocs = hostAllocCount();
+  mCounters = mPerf != nullptr ? mPerf->read() : PerfSample();
+}
+
+PhaseStats PhaseTimer::lap() {
+  auto wall = std::chrono::steady_clock::now();
+  double cpu = cpuSeconds();
+  HostAllocCount allocs = hostAllocCount();
+  PerfSample counters = mPerf != nullptr ? mPerf->read() : PerfSample();
+  PhaseStats phase{std::chrono::duration<double>(wall - mWall).count(),
+                   cpu - mCpu,
+                   HostAllocCount{allocs.Calls - mAllocs.Calls,
+                                  allocs.Bytes - mAllocs.Bytes},
+                   counters - mCounters};
+  mWall = wall;
+  mCpu = cpu;
+  mAllocs = allocs;
+  mCounters = counters;
+  return phase;
+}
+
+static void printPhase(llvm::raw_ostream &os, const char *name,
+                       const PhaseStats &phase) {
+  os << llvm::format("%-10s %12.3f %12.3f %12lu %14lu\n", name,
+                     phase.WallSeconds * 1e3, phase.CpuSeconds * 1e3,
+                     phase.Allocs.Calls, phase.Allocs.Bytes);
+}
+
+static void printPhaseCounters(llvm::raw_ostream &os, const char *name,
+                               const PhaseStats &phase) {
+  const PerfSample &counters = phase.Counters;
+  os << llvm::format("%-10s %14lu %14lu %14lu %14lu\n", name,
+                     counters.Cycles, counters.Instructions,
+                     counters.BranchMisses, counters.CacheMisses);
+}
+
+void printRunStats(const RunStats &stats, llvm::raw_ostream &os) {
+  os << "phase          wall(ms)      cpu(ms)       allocs    alloc bytes\n";
+  printPhase(os, "parse", stats.Parse);
+  printPhase(os, "init", stats.Init);
+  printPhase(os, "execute", stats.Execute);
+  printPhase(os, "teardown", stats.Teardown);
+  if (stats.HasCounters) {
+    os << "phase              cycles   instructions  branch misses   "
+          "cache misses\n";
+    printPhaseCounters(os, "parse", stats.Parse);
+    printPhaseCounters(os, "init", stats.Init);
+    printPhaseCounters(os, "execute", stats.Execute);
+    printPhaseCounters(os, "teardown", stats.Teardown);
+  }
+  os << "nodes executed    " << stats.NodesExecuted << '\n'
+     << "frames pushed     " << stats.FramesPushed << '\n'
+     << "peak frame depth  " << stats.PeakFrameDepth << '\n'
+     << "peak heap bytes   " << stats.PeakHeapBytes << '\n';
+}
+
+static llvm::json::Object phaseJSON(const PhaseStats &phase,
+                                     bool hasCounters) {
+  llvm::json::Object object{
+      {"wall_seconds", phase.WallSeconds},
+      {"cpu_seconds", phase.CpuSeconds},
+      {"alloc_calls", static_cast<int64_t>(phase.Allocs.Calls)},
+      {"alloc_bytes", static_cast<int64_t>(phase.Allocs.Bytes)},
+  };
+  if (hasCounters) {
+    const PerfSample &counters = phase.Counters;
+    object["cycles"] = static_cast<int64_t>(counters.Cycles);
+    object["instructions"] = static_cast<int64_t>(counters.Instructions);
+    object["branch_misses"] = static_cast<int64_t>(counters.BranchMisses);
+    object["cache_misses"] = static_cast<int64_t>(counters.CacheMisses);
+  }
+  return object;
+}
+
+void printRunStatsJSON(const RunStats &stats, llvm::raw_ostream &os) {
+  llvm::json::Value value = llvm::json::Object{
+      {"phases",
+       llvm::json::Object{
+           {"parse", phaseJSON(stats.Parse, stats.HasCounters)},
+           {"init", phaseJSON(stats.Init, stats.HasCounters)},
+           {"execute", phaseJSON(stats.Execute, stats.HasCounters)},
+           {"teardown", phaseJSON(stats.Teardown, stats.HasCounters)}}},
+      {"nodes_executed", static_cast<int64_t>(stats.NodesExecuted)},
+      {"frames_pushed", static_cast<int64_t>(stats.FramesPushed)},
+      {"peak_frame_depth", static_cast<int64_t>(stats.PeakFrameDepth)},
+      {"peak_heap_bytes", static_cast<int64_t>(stats.PeakHeapBytes)},
+  };
+  os << llvm::formatv("{0:2}", value) << '\n';
+}
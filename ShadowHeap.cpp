@@ -0,0 +1,111 @@
+#include "ShadowHeap.h"
+#include "RunStats.h"
+#include "Trace.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Matches the block header of Storage.cpp: the mapping length, 0 here, and
+// the number of slots. The header is never live, so it doubles as a red zone
+// between blocks.
+static const size_t kHeaderSlots = 2;
+
+ShadowHeap *gShadowHeap = nullptr;
+
+static void *reserve(size_t bytes) {
+  // untouched pages of either range cost nothing
+  void *map = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (map == MAP_FAILED) {
+    llvm::errs() << "cannot reserve " << bytes << " bytes for the heap\n";
+    fatal(nullptr);
+  }
+  return map;
+}
+
+ShadowHeap::ShadowHeap(size_t capacity)
+    : mBase(reinterpret_cast<uintptr_t>(reserve(capacity))), mSize(capacity),
+      mTop(0), mShadow(static_cast<uint8_t *>(
+                   reserve(capacity / sizeof(long)))),
+      mWhere() {}
+
+ShadowHeap::~ShadowHeap() {
+  munmap(reinterpret_cast<void *>(mBase), mSize);
+  munmap(mShadow, mSize / sizeof(long));
+}
+
+long *ShadowHeap::alloc(size_t slots) {
+  // an empty block still needs a start to be freed by
+  slots = std::max<size_t>(slots, 1);
+  size_t bytes = (slots + kHeaderSlots) * sizeof(long);
+  if (bytes > mSize - mTop) {
+    llvm::errs() << "the checked heap is exhausted after " << mTop
+                 << " bytes\n";
+    fatal(mWhere ? mWhere() : nullptr);
+  }
+  long *block = reinterpret_cast<long *>(mBase + mTop);
+  block[0] = 0;
+  block[1] = slots;
+  size_t first = mTop / sizeof(long) + kHeaderSlots;
+  mShadow[first] = kLiveStart;
+  memset(mShadow + first + 1, kLive, slots - 1);
+  mTop += bytes;
+  countHostAlloc(bytes);
+  return block + kHeaderSlots;
+}
+
+void ShadowHeap::free(long *ptr) {
+  uintptr_t offset = reinterpret_cast<uintptr_t>(ptr) - mBase;
+  uint8_t state = offset < mSize ? mShadow[offset / sizeof(long)]
+                                 : static_cast<uint8_t>(kUnallocated);
+  // the report tells a double FREE from an invalid one
+  if (state != kLiveStart || offset % sizeof(long) != 0) {
+    report("FREE of", reinterpret_cast<long>(ptr));
+  }
+  size_t slots = ptr[-1];
+  size_t first = offset / sizeof(long);
+  mShadow[first] = kFreedStart;
+  memset(mShadow + first + 1, kFreed, slots - 1);
+  // give back the whole pages inside the block; it reads as zero if it is
+  // ever touched again, which the shadow reports first
+  uintptr_t page = sysconf(_SC_PAGESIZE);
+  uintptr_t begin = (reinterpret_cast<uintptr_t>(ptr) + page - 1) & ~(page - 1);
+  uintptr_t end = (reinterpret_cast<uintptr_t>(ptr + slots)) & ~(page - 1);
+  if (begin < end) {
+    madvise(reinterpret_cast<void *>(begin), end - begin, MADV_DONTNEED);
+  }
+}
+
+void ShadowHeap::checkRange(const long *ptr, long n) const {
+  for (long i = 0; i < n; ++i) {
+    check(reinterpret_cast<long>(ptr + i));
+  }
+}
+
+void ShadowHeap::report(const char *what, long addr) const {
+  uintptr_t offset = static_cast<uintptr_t>(addr) - mBase;
+  const char *kind = "a non-heap address";
+  if (offset < mSize) {
+    switch (mShadow[offset / sizeof(long)]) {
+    case kFreed:
+    case kFreedStart:
+      kind = "a freed block";
+      break;
+    case kLive:
+      kind = "the middle of a block";
+      break;
+    case kLiveStart:
+      kind = "a live block";
+      break;
+    default:
+      kind = "outside any block";
+      break;
+    }
+  }
+  llvm::errs() << "heap check: " << what << ' ' << kind << " at 0x";
+  llvm::errs().write_hex(addr) << '\n';
+  fatal(mWhere ? mWhere() : nullptr);
+}
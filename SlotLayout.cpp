@@ -0,0 +1,100 @@
+#include "SlotLayout.h"
+#include "Trace.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/AST/RecordLayout.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+
+using namespace clang;
+
+unsigned getPointerType(QualType ty) {
+  unsigned pointerType = 0;
+  while (const PointerType *pt = dyn_cast<PointerType>(ty.getTypePtr())) {
+    ty = pt->getPointeeType();
+    ++pointerType;
+  }
+  return pointerType;
+}
+
+unsigned SlotLayout::slots(QualType ty) {
+  if (const ConstantArrayType *array =
+          dyn_cast_or_null<ConstantArrayType>(ty->getAsArrayTypeUnsafe())) {
+    return array->getSize().getZExtValue() * slots(array->getElementType());
+  }
+  if (const RecordType *record = ty->getAs<RecordType>()) {
+    return recordSlots(record->getDecl());
+  }
+  return 1;
+}
+
+unsigned SlotLayout::slots(QualType ty) const {
+  if (const ConstantArrayType *array =
+          dyn_cast_or_null<ConstantArrayType>(ty->getAsArrayTypeUnsafe())) {
+    return array->getSize().getZExtValue() * slots(array->getElementType());
+  }
+  if (const RecordType *record = ty->getAs<RecordType>()) {
+    const RecordDecl *decl = record->getDecl()->getDefinition();
+    auto it = mRecords.find(decl);
+    if (it == mRecords.end()) {
+      llvm::errs() << "record type not laid out\n";
+      fatal(gCurrentPC);
+    }
+    return it->second;
+  }
+  return 1;
+}
+
+const SlotLayout::Field &SlotLayout::field(const FieldDecl *decl) const {
+  auto it = mFields.find(decl);
+  if (it == mFields.end()) {
+    llvm::errs() << "unknown field " << decl->getName() << '\n';
+    fatal(gCurrentPC);
+  }
+  return it->second;
+}
+
+unsigned SlotLayout::recordSlots(const RecordDecl *decl) {
+  decl = decl->getDefinition();
+  if (decl == nullptr) {
+    llvm::errs() << "incomplete record type\n";
+    fatal(gCurrentPC);
+  }
+  auto it = mRecords.find(decl);
+  if (it != mRecords.end()) {
+    return it->second;
+  }
+  // the context of the translation unit that declares it
+  const ASTRecordLayout &layout =
+      decl->getASTContext().getASTRecordLayout(decl);
+  // A field starting where the previous one does shares its slots, as the
+  // members of a union do; any other field starts after all slots so far.
+  unsigned end = 0;
+  unsigned base = 0;
+  uint64_t prevBits = 0;
+  for (const FieldDecl *field : decl->fields()) {
+    uint64_t bits = layout.getFieldOffset(field->getFieldIndex());
+    if (field->getFieldIndex() == 0 || bits != prevBits) {
+      base = end;
+    }
+    prevBits = bits;
+    QualType ty = field->getType();
+    bool aggregate = ty->isRecordType() || ty->isArrayType();
+    mFields[field] = Field{base, getPointerType(ty), aggregate};
+    end = std::max(end, base + slots(ty));
+  }
+  // an empty record still has an address of its own
+  unsigned size = std::max(end, 1u);
+  mRecords[decl] = size;
+  return size;
+}
+
+const SlotLayout::Field &SlotLayout::layOut(const FieldDecl *decl) {
+  recordSlots(decl->getParent());
+  auto it = mFields.find(decl);
+  if (it == mFields.end()) {
+    llvm::errs() << "unknown field " << decl->getName() << '\n';
+    fatal(gCurrentPC);
+  }
+  return it->second;
+}
@@ -0,0 +1,57 @@
+#include "Storage.h"
+#include "RunStats.h"
+#include "Trace.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstdlib>
+#include <sys/mman.h>
+
+// Every block starts with a header recording the length of its mapping, or 0
+// if it came from calloc, so freeSlots needs nothing but the pointer, and the
+// number of slots. Two slots keep the storage 16-byte aligned.
+static const size_t kHeaderSlots = 2;
+
+static StorageOptions gOptions = {64 * 1024, false};
+
+const StorageOptions &getStorageOptions() { return gOptions; }
+
+void setStorageOptions(const StorageOptions &options) { gOptions = options; }
+
+long *allocSlots(size_t slots) {
+  size_t bytes = (slots + kHeaderSlots) * sizeof(long);
+  long *block;
+  if (bytes >= gOptions.MmapThreshold) {
+    void *map = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (map == MAP_FAILED) {
+      llvm::errs() << "out of memory mapping " << bytes << " bytes\n";
+      fatal(gCurrentPC);
+    }
+#ifdef MADV_HUGEPAGE
+    if (gOptions.HugePages) {
+      madvise(map, bytes, MADV_HUGEPAGE);
+    }
+#endif
+    block = static_cast<long *>(map);
+    block[0] = bytes;
+  } else {
+    block = static_cast<long *>(calloc(slots + kHeaderSlots, sizeof(long)));
+    if (block == nullptr) {
+      llvm::errs() << "out of memory allocating " << bytes << " bytes\n";
+      fatal(gCurrentPC);
+    }
+  }
+  block[1] = slots;
+  countHostAlloc(bytes);
+  return block + kHeaderSlots;
+}
+
+void freeSlots(long *ptr) {
+  long *block = ptr - kHeaderSlots;
+  if (block[0] != 0) {
+    munmap(block, block[0]);
+  } else {
+    free(block);
+  }
+}
+
+size_t slotCount(const long *ptr) { return (ptr - kHeaderSlots)[1]; }
@@ -0,0 +1,78 @@
+#include "SwitchTable.h"
+#include "Trace.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Stmt.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace clang;
+
+/// A table is dense when at most this many of its slots are holes, or no
+/// more holes than labels
+static const unsigned long kMaxHoles = 64;
+static const unsigned long kMaxTableSize = 1 << 16;
+
+SwitchTable SwitchTable::build(SwitchStmt *stmt, const ASTContext &context) {
+  SwitchTable table;
+  Stmt *body = stmt->getBody();
+  llvm::ArrayRef<Stmt *> children(body);
+  if (CompoundStmt *compound = dyn_cast<CompoundStmt>(body)) {
+    children = llvm::makeArrayRef(compound->body_begin(), compound->size());
+  }
+
+  unsigned found = 0;
+  unsigned long labels = 0;
+  for (unsigned i = 0; i < children.size(); ++i) {
+    Stmt *child = children[i];
+    while (SwitchCase *label = dyn_cast<SwitchCase>(child)) {
+      ++found;
+      if (CaseStmt *caseStmt = dyn_cast<CaseStmt>(label)) {
+        Expr *lhs = caseStmt->getLHS();
+        long lo = lhs->EvaluateKnownConstInt(context).getExtValue();
+        long hi = lo;
+        if (Expr *rhs = caseStmt->getRHS()) {
+          hi = rhs->EvaluateKnownConstInt(context).getExtValue();
+        }
+        if (lo <= hi) {
+          table.mRanges.push_back(Range{lo, hi, i});
+          labels += static_cast<unsigned long>(hi) - lo + 1;
+        }
+      } else {
+        table.mDefault = i;
+      }
+      child = label->getSubStmt();
+    }
+  }
+
+  unsigned total = 0;
+  for (SwitchCase *label = stmt->getSwitchCaseList(); label != nullptr;
+       label = label->getNextSwitchCase()) {
+    ++total;
+  }
+  if (found != total) {
+    llvm::errs() << "unimplemented case label inside a nested statement\n";
+    fatal(stmt);
+  }
+  if (table.mRanges.empty()) {
+    return table;
+  }
+
+  std::sort(table.mRanges.begin(), table.mRanges.end(),
+            [](const Range &a, const Range &b) { return a.Lo < b.Lo; });
+  long min = table.mRanges.front().Lo;
+  long max = min;
+  for (const Range &range : table.mRanges) {
+    max = std::max(max, range.Hi);
+  }
+  unsigned long span = static_cast<unsigned long>(max) - min + 1;
+  if (span != 0 && span <= kMaxTableSize &&
+      span - labels <= std::max(kMaxHoles, labels)) {
+    table.mDense = true;
+    table.mMin = min;
+    table.mTable.assign(span, table.mDefault);
+    for (const Range &range : table.mRanges) {
+      std::fill(table.mTable.begin() + (range.Lo - min),
+                table.mTable.begin() + (range.Hi - min + 1), range.Target);
+    }
+  }
+  return table;
+}
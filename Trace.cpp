@@ -0,0 +1,101 @@
+#include "Trace.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Stmt.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstdlib>
+#include <string>
+
+using namespace clang;
+
+thread_local TraceRing *gTraceRing = nullptr;
+thread_local const Stmt *gCurrentPC = nullptr;
+volatile std::sig_atomic_t gTraceRequested = 0;
+static thread_local bool tThrowOnFatal = false;
+
+static std::vector<const ASTContext *> gUnits;
+
+TraceRing::TraceRing(size_t capacity)
+    : mEntries(nullptr), mMask(llvm::PowerOf2Ceil(capacity) - 1), mNext(0) {
+  mEntries = new TraceEntry[mMask + 1]();
+}
+
+TraceRing::~TraceRing() { delete[] mEntries; }
+
+const ASTContext &unitOf(const std::vector<const ASTContext *> &units,
+                         const Stmt *stmt) {
+  if (units.size() > 1) {
+    // statements are allocated in the context of their unit
+    for (const ASTContext *unit : units) {
+      if (unit->getAllocator().identifyObject(stmt)) {
+        return *unit;
+      }
+    }
+  }
+  return *units.front();
+}
+
+static void printStmt(llvm::raw_ostream &os, const Stmt *stmt,
+                      const std::vector<const ASTContext *> &units) {
+  const SourceManager &sm = unitOf(units, stmt).getSourceManager();
+  os << stmt->getBeginLoc().printToString(sm) << ' '
+     << stmt->getStmtClassName();
+}
+
+void TraceRing::dump(llvm::raw_ostream &os,
+                     const std::vector<const ASTContext *> &units) const {
+  size_t size = mMask + 1;
+  size_t first = mNext > size ? mNext - size : 0;
+  os << "last " << mNext - first << " evaluated expressions:\n";
+  for (size_t i = first; i != mNext; ++i) {
+    const TraceEntry &entry = mEntries[i & mMask];
+    os << "  ";
+    printStmt(os, entry.S, units);
+    // an lvalue may point at storage that is gone by now
+    if (entry.Value.IsRValue()) {
+      os << " = " << entry.Value.RValue();
+    } else {
+      os << " = lvalue";
+    }
+    os << '\n';
+  }
+}
+
+static void requestTrace(int) { gTraceRequested = 1; }
+
+void startTrace(size_t capacity,
+                const std::vector<const ASTContext *> &units) {
+  gUnits = units;
+  if (capacity == 0) {
+    return;
+  }
+  gTraceRing = new TraceRing(capacity);
+  // printing is not safe in a signal handler, the interpreter loop polls
+  std::signal(SIGUSR1, requestTrace);
+}
+
+void dumpTrace(llvm::raw_ostream &os) {
+  if (gTraceRing != nullptr && !gUnits.empty()) {
+    gTraceRing->dump(os, gUnits);
+  }
+}
+
+void throwOnFatal(bool on) { tThrowOnFatal = on; }
+
+bool fatalThrows() { return tThrowOnFatal; }
+
+void fatal(const Stmt *pc) {
+  std::string where = "the program failed";
+  if (pc != nullptr && !gUnits.empty()) {
+    where = "while evaluating ";
+    llvm::raw_string_ostream os(where);
+    printStmt(os, pc, gUnits);
+    os.flush();
+    llvm::errs() << where << '\n';
+  }
+  dumpTrace(llvm::errs());
+  if (tThrowOnFatal) {
+    throw FatalError(where);
+  }
+  exit(-1);
+}
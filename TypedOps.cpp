@@ -0,0 +1,213 @@
+#include "TypedOps.h"
+#include "SlotLayout.h"
+#include "Trace.h"
+#include "clang/AST/Expr.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "llvm/Support/raw_ostream.h"
+#include <climits>
+#include <functional>
+#include <utility>
+
+using namespace clang;
+
+/// Both operands are integers, or pointers compared by address
+template <typename Op>
+static ObjectV2 plain(const BinopHandler &self, const ObjectV2 &l,
+                      const ObjectV2 &r) {
+  return ObjectV2(0, 0, static_cast<long>(Op()(l.RValue(), r.RValue())));
+}
+
+/// Integer l / r, or l % r if Rem. A zero divisor is reported rather than
+/// left to raise SIGFPE, and so is LONG_MIN / -1.
+template <bool Rem>
+static ObjectV2 divide(const BinopHandler &self, const ObjectV2 &l,
+                       const ObjectV2 &r) {
+  long divisor = r.RValue();
+  if (divisor == 0) {
+    llvm::errs() << "division by zero\n";
+    fatal(gCurrentPC);
+  }
+  if (divisor == -1 && l.RValue() == LONG_MIN) {
+    llvm::errs() << "division overflow\n";
+    fatal(gCurrentPC);
+  }
+  return ObjectV2(0, 0, Rem ? l.RValue() % divisor : l.RValue() / divisor);
+}
+
+/// pointer op integer. A Scale of 0 takes the scale from the handler, any
+/// other one is the common case of one slot folded into the code.
+template <typename Op, long Scale>
+static ObjectV2 pointerInt(const BinopHandler &self, const ObjectV2 &l,
+                           const ObjectV2 &r) {
+  long scale = Scale != 0 ? Scale : self.Scale;
+  return ObjectV2(self.PointerType, 0, Op()(l.RValue(), r.RValue() * scale));
+}
+
+template <long Scale>
+static ObjectV2 intPointer(const BinopHandler &self, const ObjectV2 &l,
+                           const ObjectV2 &r) {
+  long scale = Scale != 0 ? Scale : self.Scale;
+  return ObjectV2(self.PointerType, 0, l.RValue() * scale + r.RValue());
+}
+
+static ObjectV2 pointerDiff(const BinopHandler &self, const ObjectV2 &l,
+                            const ObjectV2 &r) {
+  return ObjectV2(0, 0, (l.RValue() - r.RValue()) / self.Scale);
+}
+
+template <long Scale>
+static ObjectV2 elementLValue(const BinopHandler &self, const ObjectV2 &l,
+                              const ObjectV2 &r) {
+  long scale = Scale != 0 ? Scale : self.Scale;
+  return ObjectV2(self.PointerType, 1, l.RValue() + r.RValue() * scale);
+}
+
+static ObjectV2 elementAddress(const BinopHandler &self, const ObjectV2 &l,
+                               const ObjectV2 &r) {
+  return ObjectV2(0, 0, l.RValue() + r.RValue() * self.Scale);
+}
+
+/// An operator without an implementation, whose kind is kept in Scale
+static ObjectV2 unimplemented(const BinopHandler &self, const ObjectV2 &l,
+                              const ObjectV2 &r) {
+  llvm::errs() << "unimplemented binop "
+               << BinaryOperator::getOpcodeStr(
+                      static_cast<BinaryOperatorKind>(self.Scale))
+               << '\n';
+  fatal(gCurrentPC);
+}
+
+template <typename Op>
+static BinopHandler scaled(long scale, unsigned pointerType) {
+  if (scale == sizeof(long)) {
+    return BinopHandler{pointerInt<Op, sizeof(long)>, scale, pointerType};
+  }
+  return BinopHandler{pointerInt<Op, 0>, scale, pointerType};
+}
+
+/// Bytes one step of a pointer of type ty moves over
+static long stride(QualType ty, SlotLayout &layout) {
+  return layout.slots(ty->getPointeeType()) * sizeof(long);
+}
+
+BinopHandler selectBinop(BinaryOperatorKind op, QualType lhs, QualType rhs,
+                         QualType result, SlotLayout &layout) {
+  bool lhsPointer = lhs->isPointerType();
+  bool rhsPointer = rhs->isPointerType();
+  unsigned pointerType = getPointerType(result);
+  switch (op) {
+  case BO_Add:
+    if (lhsPointer) {
+      return scaled<std::plus<long>>(stride(lhs, layout), pointerType);
+    }
+    if (rhsPointer) {
+      long scale = stride(rhs, layout);
+      if (scale == sizeof(long)) {
+        return BinopHandler{intPointer<sizeof(long)>, scale, pointerType};
+      }
+      return BinopHandler{intPointer<0>, scale, pointerType};
+    }
+    return BinopHandler{plain<std::plus<long>>, 0, 0};
+  case BO_Sub:
+    if (lhsPointer && rhsPointer) {
+      return BinopHandler{pointerDiff, stride(lhs, layout), 0};
+    }
+    if (lhsPointer) {
+      return scaled<std::minus<long>>(stride(lhs, layout), pointerType);
+    }
+    return BinopHandler{plain<std::minus<long>>, 0, 0};
+  case BO_Mul:
+    return BinopHandler{plain<std::multiplies<long>>, 0, 0};
+  case BO_Div:
+    return BinopHandler{divide<false>, 0, 0};
+  case BO_Rem:
+    return BinopHandler{divide<true>, 0, 0};
+  case BO_GT:
+    return BinopHandler{plain<std::greater<long>>, 0, 0};
+  case BO_GE:
+    return BinopHandler{plain<std::greater_equal<long>>, 0, 0};
+  case BO_LT:
+    return BinopHandler{plain<std::less<long>>, 0, 0};
+  case BO_LE:
+    return BinopHandler{plain<std::less_equal<long>>, 0, 0};
+  case BO_EQ:
+    return BinopHandler{plain<std::equal_to<long>>, 0, 0};
+  case BO_NE:
+    return BinopHandler{plain<std::not_equal_to<long>>, 0, 0};
+  default:
+    return BinopHandler{unimplemented, op, 0};
+  }
+}
+
+BinopHandler selectSubscript(QualType element, SlotLayout &layout) {
+  long scale = layout.slots(element) * sizeof(long);
+  if (element->isRecordType() || element->isArrayType()) {
+    return BinopHandler{elementAddress, scale, 0};
+  }
+  unsigned pointerType = getPointerType(element);
+  if (scale == sizeof(long)) {
+    return BinopHandler{elementLValue<sizeof(long)>, scale, pointerType};
+  }
+  return BinopHandler{elementLValue<0>, scale, pointerType};
+}
+
+namespace {
+class OperationVisitor : public RecursiveASTVisitor<OperationVisitor> {
+public:
+  OperationVisitor(SlotLayout &layout, QualType intTy)
+      : Layout(layout), IntTy(intTy), Ops() {}
+
+  bool VisitBinaryOperator(BinaryOperator *bop) {
+    BinaryOperatorKind op = bop->getOpcode();
+    // evaluated without a handler
+    if (op == BO_Assign || op == BO_Comma || bop->isLogicalOp()) {
+      return true;
+    }
+    QualType result = bop->getType();
+    if (CompoundAssignOperator *assign =
+            dyn_cast<CompoundAssignOperator>(bop)) {
+      op = BinaryOperator::getOpForCompoundAssignment(op);
+      result = assign->getComputationResultType();
+    }
+    Ops.emplace_back(bop, selectBinop(op, bop->getLHS()->getType(),
+                                      bop->getRHS()->getType(), result,
+                                      Layout));
+    return true;
+  }
+
+  bool VisitUnaryOperator(UnaryOperator *uop) {
+    if (uop->isIncrementDecrementOp()) {
+      // x++ is x + 1 in the type of x
+      QualType ty = uop->getSubExpr()->getType();
+      BinaryOperatorKind op = uop->isIncrementOp() ? BO_Add : BO_Sub;
+      Ops.emplace_back(uop, selectBinop(op, ty, IntTy, ty, Layout));
+    }
+    return true;
+  }
+
+  bool VisitArraySubscriptExpr(ArraySubscriptExpr *expr) {
+    Ops.emplace_back(expr, selectSubscript(expr->getType(), Layout));
+    return true;
+  }
+
+  SlotLayout &Layout;
+  QualType IntTy;
+  std::vector<std::pair<const Stmt *, BinopHandler>> Ops;
+};
+} // namespace
+
+HandlerTable HandlerTable::build(FunctionDecl *function, SlotLayout &layout) {
+  OperationVisitor visitor(layout, function->getASTContext().IntTy);
+  visitor.TraverseDecl(function);
+  std::sort(visitor.Ops.begin(), visitor.Ops.end(),
+            [](const std::pair<const Stmt *, BinopHandler> &a,
+               const std::pair<const Stmt *, BinopHandler> &b) {
+              return a.first < b.first;
+            });
+  HandlerTable table;
+  for (auto &op : visitor.Ops) {
+    table.mOps.push_back(op.first);
+    table.mHandlers.push_back(op.second);
+  }
+  return table;
+}
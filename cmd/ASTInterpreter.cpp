@@ -2,53 +2,335 @@
 //--------------===//
 //===----------------------------------------------------------------------===//
 
-#include "clang/AST/ASTConsumer.h"
-#include "clang/Frontend/CompilerInstance.h"
-#include "clang/Frontend/FrontendAction.h"
+#include "clang/Frontend/ASTUnit.h"
 #include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/ThreadPool.h"
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
 
 using namespace clang;
 
 #include "Environment.h"
+#include "HeapProfile.h"
+#include "Inlining.h"
 #include "InterpreterVisitor.h"
+#include "LoopInvariants.h"
+#include "ParallelFor.h"
+#include "PerfCounters.h"
+#include "Repl.h"
+#include "RunStats.h"
+#include "ShadowHeap.h"
+#include "Storage.h"
+#include "Trace.h"
 
-class InterpreterConsumer : public ASTConsumer {
-public:
-  explicit InterpreterConsumer(const ASTContext &context)
-      : mEnv(), mVisitor(context, &mEnv) {}
-  virtual ~InterpreterConsumer() {}
+static llvm::cl::OptionCategory InterpreterCategory("ast-interpreter options");
 
-  virtual void HandleTranslationUnit(clang::ASTContext &Context) override {
-    TranslationUnitDecl *decl = Context.getTranslationUnitDecl();
-    mEnv.init(decl, &mVisitor);
+static llvm::cl::list<std::string>
+    Inputs(llvm::cl::Positional,
+           llvm::cl::desc("<program source> | <file.c>..."),
+           llvm::cl::cat(InterpreterCategory));
 
-    FunctionDecl *entry = mEnv.getEntry();
-    mVisitor.VisitStmt(entry->getBody());
-    auto regRet = mEnv.getMainRet();
+static llvm::cl::opt<bool>
+    Interactive("repl",
+                llvm::cl::desc("Read snippets from stdin and run each one as "
+                               "it is complete"),
+                llvm::cl::cat(InterpreterCategory));
+
+static llvm::cl::opt<bool>
+    PrintStats("stats", llvm::cl::desc("Print statistics about the run"),
+               llvm::cl::cat(InterpreterCategory));
+
+static llvm::cl::opt<bool>
+    StatsJSON("stats-json",
+              llvm::cl::desc("Print statistics about the run as JSON"),
+              llvm::cl::cat(InterpreterCategory));
+
+static llvm::cl::opt<unsigned long> MmapThreshold(
+    "mmap-threshold",
+    llvm::cl::desc("Map arrays and MALLOC blocks of at least this many bytes "
+                   "lazily from the kernel"),
+    llvm::cl::init(getStorageOptions().MmapThreshold),
+    llvm::cl::cat(InterpreterCategory));
+
+static llvm::cl::opt<bool>
+    HugePages("huge-pages",
+              llvm::cl::desc("Use transparent huge pages for mapped blocks"),
+              llvm::cl::cat(InterpreterCategory));
+
+static llvm::cl::opt<bool> CheckHeap(
+    "check-heap",
+    llvm::cl::desc("Stop at invalid and double FREEs and at accesses to "
+                   "freed MALLOC blocks"),
+    llvm::cl::cat(InterpreterCategory));
+
+static llvm::cl::opt<bool> ProfileHeap(
+    "heap-profile",
+    llvm::cl::desc("Print the MALLOC sites by peak usage and the blocks "
+                   "never freed after the run"),
+    llvm::cl::cat(InterpreterCategory));
+
+static llvm::cl::opt<unsigned> InlineThreshold(
+    "inline-threshold",
+    llvm::cl::desc("Inline non-recursive callees of at most this many AST "
+                   "nodes, 0 disables inlining"),
+    llvm::cl::init(getInlineOptions().Threshold),
+    llvm::cl::cat(InterpreterCategory));
+
+static llvm::cl::opt<bool>
+    InlineReport("inline-report",
+                 llvm::cl::desc("Print the inlined call sites after the run"),
+                 llvm::cl::cat(InterpreterCategory));
+
+static llvm::cl::opt<bool> LoopOpt(
+    "loop-opt",
+    llvm::cl::desc("Hoist invariant expressions out of loops and turn "
+                   "multiplications of induction variables into additions"),
+    llvm::cl::init(getLoopOptions().Enabled),
+    llvm::cl::cat(InterpreterCategory));
+
+static llvm::cl::opt<bool>
+    LoopReport("loop-report",
+               llvm::cl::desc("Print the hoisted and strength-reduced "
+                              "expressions of each loop after the run"),
+               llvm::cl::cat(InterpreterCategory));
+
+static llvm::cl::opt<unsigned> OmpThreads(
+    "omp-threads",
+    llvm::cl::desc("Threads running `#pragma omp parallel for` loops, 1 runs "
+                   "them sequentially"),
+    llvm::cl::init(getParallelOptions().Threads),
+    llvm::cl::cat(InterpreterCategory));
+
+static llvm::cl::opt<unsigned long> MaxSteps(
+    "max-steps",
+    llvm::cl::desc("Stop the program after this many AST nodes, 0 for no "
+                   "limit"),
+    llvm::cl::init(0), llvm::cl::cat(InterpreterCategory));
+
+static llvm::cl::opt<double> MaxSeconds(
+    "max-seconds",
+    llvm::cl::desc("Stop the program after this many seconds, 0 for no "
+                   "limit"),
+    llvm::cl::init(0), llvm::cl::cat(InterpreterCategory));
+
+static llvm::cl::opt<unsigned> TraceSize(
+    "trace",
+    llvm::cl::desc("Keep the last N evaluated expressions and print them on "
+                   "an error or SIGUSR1"),
+    llvm::cl::value_desc("N"), llvm::cl::init(0),
+    llvm::cl::cat(InterpreterCategory));
+
+static llvm::cl::opt<bool> PerfPhases(
+    "perf",
+    llvm::cl::desc("Count cycles, instructions, branch and cache misses of "
+                   "each phase with -stats"),
+    llvm::cl::cat(InterpreterCategory));
+
+static llvm::cl::opt<bool> PerfFunctions(
+    "perf-functions",
+    llvm::cl::desc("Also charge the counts to the interpreted functions, "
+                   "read at every call and return"),
+    llvm::cl::cat(InterpreterCategory));
+
+/// Address space reserved for the MALLOC blocks of a -check-heap run
+static const size_t kCheckedHeapBytes = size_t(64) << 30;
+
+/// The exit status of a program stopped by -max-steps or -max-seconds
+static const int kBudgetExceeded = 3;
+static int gExitCode = 0;
+
+static PerfCounters gPerf;
+static PhaseTimer gPhases;
+static RunStats gRunStats;
+
+// Replacing the global operator new counts every host allocation of this
+// binary, whatever container or library makes it. new[] and the nothrow
+// forms call it too. It lives here rather than in ast-interpreter-lib, whose
+// other users keep their own allocator.
+void *operator new(std::size_t size) {
+  countHostAlloc(size);
+  if (size == 0) {
+    size = 1;
+  }
+  for (;;) {
+    if (void *ptr = malloc(size)) {
+      return ptr;
+    }
+    std::new_handler handler = std::get_new_handler();
+    if (handler == nullptr) {
+      throw std::bad_alloc();
+    }
+    handler();
+  }
+}
+
+void operator delete(void *ptr) noexcept { free(ptr); }
+
+void operator delete(void *ptr, std::size_t) noexcept { free(ptr); }
+
+/// Parse the inputs, each file on a thread of the pool. Inputs that are not
+/// all files are taken as the source of a program, as before files were
+/// supported. Returns nothing if an input does not compile.
+static std::vector<std::unique_ptr<ASTUnit>> parseInputs() {
+  // -fopenmp keeps `#pragma omp parallel for` in the AST
+  std::vector<std::string> args = {"-fopenmp"};
+  std::vector<std::unique_ptr<ASTUnit>> units(Inputs.size());
+  if (!llvm::all_of(Inputs, [](const std::string &input) {
+        return llvm::sys::fs::is_regular_file(input);
+      })) {
+    if (Inputs.size() != 1) {
+      llvm::errs() << "cannot read the program files\n";
+      return {};
+    }
+    units[0] = clang::tooling::buildASTFromCodeWithArgs(Inputs[0], args);
+  } else {
+    // a .c file is still parsed as C++, like source given as an argument
+    args.insert(args.begin(), "-xc++");
+    llvm::ThreadPool pool;
+    for (size_t i = 0; i < Inputs.size(); ++i) {
+      pool.async([i, &args, &units] {
+        auto file = llvm::MemoryBuffer::getFile(Inputs[i]);
+        if (!file) {
+          llvm::errs() << "cannot read " << Inputs[i] << '\n';
+          return;
+        }
+        units[i] = clang::tooling::buildASTFromCodeWithArgs(
+            (*file)->getBuffer(), args, Inputs[i]);
+      });
+    }
+    pool.wait();
+  }
+  for (const std::unique_ptr<ASTUnit> &unit : units) {
+    if (!unit || unit->getDiagnostics().hasErrorOccurred()) {
+      return {};
+    }
+  }
+  return units;
+}
+
+static void runProgram(std::vector<std::unique_ptr<ASTUnit>> &units) {
+  gRunStats.Parse = gPhases.lap();
+  std::vector<const ASTContext *> contexts;
+  std::vector<TranslationUnitDecl *> decls;
+  for (std::unique_ptr<ASTUnit> &unit : units) {
+    contexts.push_back(&unit->getASTContext());
+    decls.push_back(unit->getASTContext().getTranslationUnitDecl());
+  }
+  startTrace(TraceSize, contexts);
+  Environment env;
+  InterpreterVisitor visitor(&env);
+  env.init(decls);
+  if (PerfFunctions && gPerf.available()) {
+    env.setPerfCounters(&gPerf);
+  }
+  HeapProfile heapProfile;
+  if (ProfileHeap) {
+    env.setHeapProfile(&heapProfile);
+  }
+  gRunStats.Init = gPhases.lap();
+
+  FunctionDecl *entry = env.getEntry();
+  if (entry == nullptr) {
+    llvm::errs() << "no main function\n";
+    fatal(nullptr);
+  }
+  visitor.setBudget(ExecutionBudget{MaxSteps, MaxSeconds});
+  RunStatus status = visitor.Execute(entry->getBody());
+  gRunStats.Execute = gPhases.lap();
+  if (PerfFunctions && gPerf.available()) {
+    // main has no call boundary of its own to end it
+    env.chargeCounters();
+  }
+  gRunStats.NodesExecuted = visitor.nodesExecuted();
+  gRunStats.FramesPushed = env.framesPushed();
+  gRunStats.PeakFrameDepth = env.peakFrameDepth();
+  gRunStats.PeakHeapBytes = env.peakHeapBytes();
+  if (status == RunStatus::BudgetExceeded) {
+    env.output().flush();
+    llvm::errs() << "\nexecution budget exceeded\n";
+    gExitCode = kBudgetExceeded;
+  } else {
+    auto regRet = env.getMainRet();
     if (regRet != 0) {
       // llvm::dbgs() << "main returns " << regRet << "\n";
     }
   }
+  if (PrintStats) {
+    env.printFunctionStats(llvm::outs());
+  }
+  if (InlineReport) {
+    env.printInlineReport(llvm::errs());
+  }
+  if (LoopReport) {
+    env.printLoopReport(llvm::errs());
+  }
+  if (ProfileHeap) {
+    env.printHeapProfile(llvm::errs());
+  }
+}
 
-private:
-  Environment mEnv;
-  InterpreterVisitor mVisitor;
-};
-
-class InterpreterClassAction : public ASTFrontendAction {
-public:
-  virtual std::unique_ptr<clang::ASTConsumer>
-  CreateASTConsumer(clang::CompilerInstance &Compiler, llvm::StringRef InFile) {
-    return std::unique_ptr<clang::ASTConsumer>(
-        new InterpreterConsumer(Compiler.getASTContext()));
+static void runRepl() {
+  Repl repl;
+  repl.setBudget(ExecutionBudget{MaxSteps, MaxSeconds});
+  std::string snippet;
+  std::string line;
+  llvm::errs() << "> ";
+  while (std::getline(std::cin, line)) {
+    snippet += line;
+    snippet += '\n';
+    if (!Repl::isComplete(snippet)) {
+      llvm::errs() << ". ";
+      continue;
+    }
+    if (!llvm::StringRef(snippet).trim().empty()) {
+      repl.eval(snippet);
+    }
+    snippet.clear();
+    llvm::errs() << "> ";
   }
-};
+}
 
 int main(int argc, char **argv) {
-  if (argc > 1) {
-    clang::tooling::runToolOnCode(
-        std::unique_ptr<clang::FrontendAction>(new InterpreterClassAction),
-        argv[1]);
+  llvm::cl::HideUnrelatedOptions(InterpreterCategory);
+  llvm::cl::ParseCommandLineOptions(argc, argv, "AST interpreter\n");
+  setStorageOptions(StorageOptions{MmapThreshold, HugePages});
+  setInlineOptions(InlineOptions{InlineThreshold});
+  setLoopOptions(LoopOptions{LoopOpt});
+  setParallelOptions(ParallelOptions{OmpThreads});
+  if (CheckHeap) {
+    gShadowHeap = new ShadowHeap(kCheckedHeapBytes);
+  }
+  if ((PerfPhases || PerfFunctions) && !gPerf.open()) {
+    llvm::errs() << "hardware counters are not available, running without "
+                    "them\n";
+  }
+  gPhases.setCounters(&gPerf);
+  gRunStats.HasCounters = gPerf.available();
+  if (Interactive) {
+    runRepl();
+  } else if (!Inputs.empty()) {
+    gPhases.restart();
+    std::vector<std::unique_ptr<ASTUnit>> units = parseInputs();
+    if (units.empty()) {
+      return 1;
+    }
+    runProgram(units);
+    units.clear();
+    gRunStats.Teardown = gPhases.lap();
+    if (PrintStats) {
+      printRunStats(gRunStats, llvm::outs());
+    }
+    if (StatsJSON) {
+      printRunStatsJSON(gRunStats, llvm::outs());
+    }
   }
-  return 0;
+  return gExitCode;
 }
@@ -0,0 +1,285 @@
+//==--- cmd/ASTServer.cpp - Serve an interpreted program over TCP ---------===//
+//
+// ast-interpreter-server <port> <program.c> [threads] [max-steps] [max-seconds]
+//
+// Every connection runs its own instance of the program. PRINT writes to the
+// connection and GET reads whitespace separated integers from it. A session
+// waiting in GET is only its interpreter state, so a few epoll threads serve
+// many interactive sessions. A session that runs over its budget is told so
+// and closed, so a looping program cannot hold on to a thread, and so is one
+// whose program fails, without taking the other sessions down with it.
+//===----------------------------------------------------------------------===//
+
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace clang;
+
+#include "Environment.h"
+#include "InterpreterVisitor.h"
+#include "ParallelFor.h"
+#include "Trace.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <netinet/in.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+static ExecutionBudget gBudget = {0, 0};
+
+class Session {
+public:
+  Session(int fd, ASTContext &context)
+      : mFd(fd), mEnv(), mVisitor(&mEnv), mOutBuf(), mOut(mOutBuf),
+        mIn(), mSent(0), mFinished(false), mInputEnded(false),
+        mClosed(false) {
+    mEnv.setOutput(mOut);
+    mEnv.setAsyncInput(true);
+    try {
+      mEnv.init(context.getTranslationUnitDecl());
+      mVisitor.setBudget(gBudget);
+      mVisitor.Start(mEnv.getEntry()->getBody());
+    } catch (const FatalError &error) {
+      fail(error);
+    }
+  }
+
+  int fd() const { return mFd; }
+
+  /// Queue the integers in data for GET; a trailing partial number waits for
+  /// the rest of it
+  void feed(const char *data, size_t n) {
+    mIn.append(data, n);
+    size_t pos = 0;
+    for (;;) {
+      size_t begin = mIn.find_first_not_of(" \t\r\n", pos);
+      if (begin == std::string::npos) {
+        pos = mIn.size();
+        break;
+      }
+      size_t end = mIn.find_first_of(" \t\r\n", begin);
+      if (end == std::string::npos) {
+        pos = begin;
+        break;
+      }
+      mEnv.provideInput(strtol(mIn.c_str() + begin, nullptr, 10));
+      pos = end;
+    }
+    mIn.erase(0, pos);
+  }
+
+  /// Run the program as far as the queued input allows
+  void advance() {
+    if (!mFinished) {
+      try {
+        RunStatus status = mVisitor.Resume();
+        if (status == RunStatus::BudgetExceeded) {
+          mOut << "\nexecution budget exceeded\n";
+        }
+        mFinished = status != RunStatus::Suspended;
+      } catch (const FatalError &error) {
+        fail(error);
+      }
+      mOut.flush();
+    }
+  }
+
+  /// Write out what the program printed. Returns false if some of it has to
+  /// wait for the socket to drain.
+  bool flush() {
+    while (mSent < mOutBuf.size()) {
+      ssize_t n = write(mFd, mOutBuf.data() + mSent, mOutBuf.size() - mSent);
+      if (n < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          return false;
+        }
+        mClosed = true;
+        return true;
+      }
+      mSent += n;
+    }
+    mOutBuf.clear();
+    mSent = 0;
+    return true;
+  }
+
+  /// The peer will send nothing more
+  void endInput() { mInputEnded = true; }
+  void close() { mClosed = true; }
+
+  /// Nothing is left to do once the program has ended, or waits for input
+  /// that cannot come, and everything it printed has been sent
+  bool done() const {
+    return mClosed || ((mFinished || mInputEnded) && mOutBuf.empty());
+  }
+
+private:
+  /// The program hit an error: tell the peer where and end the session. The
+  /// error itself went to the server's stderr.
+  void fail(const FatalError &error) {
+    mOut << "\nerror: " << error.what() << '\n';
+    mOut.flush();
+    mFinished = true;
+  }
+
+  int mFd;
+  Environment mEnv;
+  InterpreterVisitor mVisitor;
+  std::string mOutBuf;
+  llvm::raw_string_ostream mOut;
+  std::string mIn;
+  size_t mSent;
+  bool mFinished;
+  bool mInputEnded;
+  bool mClosed;
+};
+
+static int listenOn(int port) {
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  int one = 1;
+  // every thread listens on the port and the kernel spreads connections
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+      listen(fd, SOMAXCONN) < 0) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static void watch(int epfd, int op, Session &session, bool wantWrite) {
+  epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN | EPOLLRDHUP | (wantWrite ? EPOLLOUT : 0);
+  ev.data.fd = session.fd();
+  epoll_ctl(epfd, op, session.fd(), &ev);
+}
+
+static void serve(int port, ASTContext &context) {
+  throwOnFatal(true);
+  int listener = listenOn(port);
+  if (listener < 0) {
+    llvm::errs() << "cannot listen on port " << port << ": "
+                 << strerror(errno) << '\n';
+    exit(-1);
+  }
+  int epfd = epoll_create1(0);
+  epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = listener;
+  epoll_ctl(epfd, EPOLL_CTL_ADD, listener, &ev);
+
+  std::unordered_map<int, std::unique_ptr<Session>> sessions;
+  std::vector<epoll_event> events(256);
+  char buf[4096];
+  for (;;) {
+    int n = epoll_wait(epfd, events.data(), events.size(), -1);
+    for (int i = 0; i < n; ++i) {
+      int fd = events[i].data.fd;
+      if (fd == listener) {
+        int client;
+        while ((client = accept4(listener, nullptr, nullptr,
+                                 SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+          auto session = std::make_unique<Session>(client, context);
+          session->advance();
+          bool drained = session->flush();
+          if (session->done()) {
+            ::close(client);
+            continue;
+          }
+          watch(epfd, EPOLL_CTL_ADD, *session, !drained);
+          sessions[client] = std::move(session);
+        }
+        continue;
+      }
+      auto it = sessions.find(fd);
+      if (it == sessions.end()) {
+        continue;
+      }
+      Session &session = *it->second;
+      if (events[i].events & EPOLLIN) {
+        ssize_t got;
+        while ((got = read(fd, buf, sizeof(buf))) > 0) {
+          session.feed(buf, got);
+        }
+        if (got == 0) {
+          session.endInput();
+        }
+        session.advance();
+      }
+      if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+        session.close();
+      }
+      bool drained = session.flush();
+      if (session.done()) {
+        ::close(fd);
+        sessions.erase(it);
+      } else {
+        watch(epfd, EPOLL_CTL_MOD, session, !drained);
+      }
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    llvm::errs() << "usage: " << argv[0]
+                 << " <port> <program.c> [threads] [max-steps] [max-seconds]\n";
+    return 1;
+  }
+  int port = atoi(argv[1]);
+  auto file = llvm::MemoryBuffer::getFile(argv[2]);
+  if (!file) {
+    llvm::errs() << "cannot read " << argv[2] << '\n';
+    return 1;
+  }
+  std::unique_ptr<ASTUnit> unit =
+      clang::tooling::buildASTFromCode((*file)->getBuffer());
+  if (!unit) {
+    return 1;
+  }
+  unsigned threads =
+      argc > 3 ? atoi(argv[3]) : std::thread::hardware_concurrency();
+  if (threads == 0) {
+    threads = 1;
+  }
+  gBudget.MaxSteps = argc > 4 ? strtoul(argv[4], nullptr, 10) : 0;
+  gBudget.MaxSeconds = argc > 5 ? atof(argv[5]) : 0;
+  // The threads share the AST. ASTContext computes record layouts and type
+  // sizes on first use, so compute them all here for the threads to only
+  // read. Constant initializers are evaluated one thread at a time.
+  ASTContext &context = unit->getASTContext();
+  // only for fatal to tell where an error is
+  startTrace(0, {&context});
+  SlotLayout layout;
+  warmLayouts(context.getTranslationUnitDecl(), layout, context);
+  std::vector<std::thread> workers;
+  for (unsigned i = 0; i < threads; ++i) {
+    workers.emplace_back(serve, port, std::ref(context));
+  }
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+  return 0;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "ObjectV2.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace clang {
+class CallExpr;
+} // namespace clang
+
+class Environment;
+
+/// A native function the interpreted program calls by name, e.g. PRINT.
+/// The call's arguments are already evaluated when the handler runs; it reads
+/// them with Environment::getArg and returns the value of the call.
+using BuiltinFn = ObjectV2 (*)(Environment &env, clang::CallExpr *callexpr);
+
+/// Returns the builtin called name, or nullptr
+BuiltinFn lookupBuiltin(llvm::StringRef name);
@@ -2,15 +2,30 @@
 //--------------===//
 //===----------------------------------------------------------------------===//
 #pragma once
+#include "Builtins.h"
+#include "HeapProfile.h"
+#include "LocalSlots.h"
+#include "LoopInvariants.h"
 #include "ObjectV2.h"
+#include "ParallelFor.h"
+#include "PerfCounters.h"
+#include "SlotLayout.h"
+#include "Trace.h"
+#include "TypedOps.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
 #include <deque>
 #include <map>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 
 namespace clang {
+class APValue;
+class ASTContext;
 class Decl;
 class Stmt;
 class FunctionDecl;
@@ -18,6 +33,7 @@ class TranslationUnitDecl;
 class IntegerLiteral;
 class CharacterLiteral;
 class BinaryOperator;
+class ConditionalOperator;
 class UnaryOperator;
 class UnaryExprOrTypeTraitExpr;
 class DeclStmt;
@@ -26,15 +42,19 @@ class CastExpr;
 class CallExpr;
 class CompoundStmt;
 class VarDecl;
+class ValueDecl;
 class ReturnStmt;
 class QualType;
 class Expr;
 class ParenExpr;
 class ArraySubscriptExpr;
 class ImplicitCastExpr;
+class MemberExpr;
+class CXXConstructExpr;
+class CXXOperatorCallExpr;
+class OMPParallelForDirective;
 } // namespace clang
 
-class InterpreterVisitor;
 using namespace clang;
 
 class StackFrame {
@@ -69,9 +89,18 @@ public:
 
   ~StackFrame();
   void bindDecl(Decl *decl, ObjectV2 val);
+  bool hasDecl(Decl *decl) const { return mVars.count(decl) != 0; }
+  /// Bind the variables of frame that are not bound here yet
+  void inheritVars(const StackFrame &frame) {
+    mVars.insert(frame.mVars.begin(), frame.mVars.end());
+  }
+  int father() const { return mFatherID; }
   ObjectV2 getDeclValRef(std::deque<StackFrame> &stack, Decl *declname);
 
-  void bindStmt(Stmt *stmt, ObjectV2 val) { mExprs[stmt] = (val); }
+  void bindStmt(Stmt *stmt, ObjectV2 val) {
+    traceValue(stmt, val);
+    mExprs[stmt] = (val);
+  }
 
   ObjectV2 getStmtVal(Stmt *stmt) const {
     auto res1 = mExprs.find(stmt);
@@ -79,71 +108,337 @@ public:
     return res1->second;
   }
 
-  void setPC(Stmt *stmt) { mPC = stmt; }
+  void setPC(Stmt *stmt) {
+    mPC = stmt;
+    gCurrentPC = stmt;
+  }
   Stmt *getPC() const { return mPC; }
 };
 
+struct FunctionInfo;
+
+/// A call whose callee runs without a frame of its own. Its locals take a
+/// window of the caller's slots.
+struct InlineSite {
+  const FunctionInfo *Callee;
+  unsigned SlotBase;
+  /// Counted by the Environment that prepared it only
+  mutable unsigned Calls;
+};
+
+/// A user-defined function. Environment::init only registers it; the work
+/// its calls rely on is done on the first call, so functions a run never
+/// calls cost no more than this stub.
+struct FunctionInfo {
+  FunctionDecl *Definition;
+  bool Prepared;
+  /// Pointer depth of each parameter
+  std::vector<unsigned> ParamPointerTypes;
+  /// Locals kept out of the StackFrame maps
+  LocalSlots Locals;
+  /// What its loops compute on entry instead of on every iteration
+  LoopInvariants Loops;
+  /// How each of its operations computes its result
+  HandlerTable Handlers;
+  /// Calls inlined into this function
+  std::unordered_map<CallExpr *, InlineSite> Inlined;
+  /// Slots of an activation: the locals, the values of Loops, then the
+  /// windows of inlined calls
+  unsigned SlotCount;
+
+  /// Statistics, counted by the Environment that prepared the function
+  /// only. The workers of a parallel loop share it read-only.
+  mutable unsigned Calls;
+  double PrepareSeconds;
+  /// Hardware events while this function itself ran, without its callees
+  mutable PerfSample Counters;
+
+  FunctionInfo()
+      : Definition(nullptr), Prepared(false), ParamPointerTypes(), Locals(),
+        Loops(), Handlers(), Inlined(), SlotCount(0), Calls(0),
+        PrepareSeconds(0), Counters() {}
+};
+
 class Environment {
   std::deque<StackFrame> mStack;
 
-  FunctionDecl *mFree; /// Declartions to the built-in functions
-  FunctionDecl *mMalloc;
-  FunctionDecl *mInput;
-  FunctionDecl *mOutput;
+  /// Declartions to the built-in functions
+  std::unordered_map<FunctionDecl *, BuiltinFn> mBuiltins;
+  /// User-defined functions by canonical declaration
+  std::unordered_map<FunctionDecl *, FunctionInfo> mFunctions;
+  /// Functions and globals only declared in their translation unit, to
+  /// their definition in another one
+  std::unordered_map<FunctionDecl *, FunctionDecl *> mFunctionLinks;
+  std::unordered_map<Decl *, VarDecl *> mGlobalLinks;
 
   FunctionDecl *mEntry;
 
+  /// The context of each translation unit of the program
+  std::vector<const ASTContext *> mUnits;
+  /// Slot offsets of struct and union fields
+  SlotLayout mLayout;
+
+  /// The unboxed locals of a running function
+  struct Activation {
+    const FunctionInfo *Function;
+    long *Slots;
+    /// The call that began it, nullptr for the entry
+    CallExpr *Call;
+  };
+  std::vector<Activation> mActivations;
+  /// Slot arrays by call depth, reused across calls
+  std::vector<std::vector<long>> mSlotPool;
+
+  /// `#pragma omp parallel for` loops met so far
+  std::unordered_map<Stmt *, ParallelLoop> mParallelLoops;
+
   std::unordered_set<long *> mHeap;
+  /// Told of every MALLOC and FREE when set, see setHeapProfile
+  HeapProfile *mHeapProfile;
 
-  InterpreterVisitor *mVisitor;
+  /// Counters for -stats
+  unsigned long mFramesPushed;
+  size_t mPeakFrames;
+  size_t mHeapSlots;
+  size_t mPeakHeapSlots;
+  /// Read at call boundaries when set, see setPerfCounters
+  const PerfCounters *mPerf;
+  PerfSample mPerfMark;
 
   ObjectV2 mRetReg;
 
-public:
-  bool mReturned;
+  /// Where PRINT and the GET prompt write to
+  llvm::raw_ostream *mOut;
 
+  /// Of a worker, the Environment running its parallel loop. The functions,
+  /// links and layout prepared there are read from it instead of copied.
+  const Environment *mParent;
+
+  /// Integers for GET when they arrive asynchronously, e.g. from a socket,
+  /// instead of being read from stdin
+  bool mAsyncInput;
+  std::deque<long> mInput;
+  bool mWaitingInput;
+
+public:
   /// Get the declartions to the built-in functions
   Environment()
-      : mStack(), mFree(NULL), mMalloc(NULL), mInput(NULL), mOutput(NULL),
-        mEntry(NULL), mReturned(false) {}
+      : mStack(), mBuiltins(), mFunctions(), mFunctionLinks(), mGlobalLinks(),
+        mEntry(NULL), mUnits(),
+        mLayout(), mActivations(), mSlotPool(),
+        mParallelLoops(), mHeap(), mHeapProfile(nullptr),
+        mFramesPushed(0), mPeakFrames(0), mHeapSlots(0), mPeakHeapSlots(0),
+        mPerf(nullptr), mPerfMark(),
+        mOut(&llvm::errs()), mParent(nullptr), mAsyncInput(false), mInput(),
+        mWaitingInput(false) {}
 
   /// Initialize the Environment
-  void init(TranslationUnitDecl *unit, InterpreterVisitor *mVisitor);
+  void init(TranslationUnitDecl *unit);
+  /// Initialize the Environment of a program made of several translation
+  /// units. Functions and globals declared in one and defined in another
+  /// are linked by name.
+  void init(const std::vector<TranslationUnitDecl *> &units);
+  /// Add top-level declarations parsed after init, e.g. by the REPL. They
+  /// may refer to everything declared before.
+  void declare(const std::vector<Decl *> &decls);
+  /// Initialize the Environment of a worker running iterations of a
+  /// parallel loop in parent. It reads the prepared program of parent, which
+  /// must not change until the worker is done, shares the storage of
+  /// arrays, structs and MALLOC blocks with it, and starts with private
+  /// copies of the scalars in scope there.
+  void initWorker(const Environment &parent);
 
   FunctionDecl *getEntry() { return mEntry; }
+  /// The context of the translation unit holding stmt
+  const ASTContext &contextOf(const Stmt *stmt) const {
+    return unitOf(shared().mUnits, stmt);
+  }
+  const std::vector<const ASTContext *> &units() const { return mUnits; }
+  /// The definition of the user-defined function called name, or nullptr
+  FunctionDecl *lookupFunction(llvm::StringRef name) const;
+
+  /// Begin a call of fn from outside the program, binding args to its
+  /// parameters as call does for a call expression. Returns the body to
+  /// run; leave ends the call.
+  Stmt *enter(FunctionDecl *fn, const std::vector<long> &args);
+  /// End the call begun by the enter that found the Environment at these
+  /// depths, also one that stopped early, and return its result
+  long leave(size_t frameDepth, size_t activationDepth);
+  size_t activationDepth() const { return mActivations.size(); }
 
   void intLiteral(IntegerLiteral *int_lit);
   void charLiteral(CharacterLiteral *char_lit);
 
   void binop(BinaryOperator *bop);
+  /// Whether the comparison bop holds, once its operands are evaluated. The
+  /// outcome decides a branch and is not bound to bop.
+  bool compare(BinaryOperator *bop);
+  /// The result of && or || once the operand deciding it is known
+  void logical(BinaryOperator *bop, bool value);
+  /// The result of ?: once the selected arm is evaluated
+  void conditional(ConditionalOperator *expr, Expr *arm);
   void unary(UnaryOperator *uop);
   void unaryOrTypeTrait(UnaryExprOrTypeTraitExpr *expr);
 
   void decl(DeclStmt *declstmt);
   void declref(DeclRefExpr *declref);
   void paren(ParenExpr *paren);
-  void call(CallExpr *callexpr);
+  /// Calls a builtin right away and returns nullptr, or pushes the callee's
+  /// frame and returns the body to run. callReturn ends the latter.
+  Stmt *call(CallExpr *callexpr);
+  void callReturn(CallExpr *callexpr, size_t frameDepth);
   void implicitCast(ImplicitCastExpr *expr);
+  /// Reads an unboxed local straight from its slot when expr is the
+  /// lvalue-to-rvalue conversion of one. Returns false otherwise, and expr
+  /// is evaluated as usual.
+  bool loadLocal(ImplicitCastExpr *expr);
+  /// Reads an expression hoisted out of a loop, or a strength-reduced
+  /// product, from its slot. Returns false if bop is evaluated as usual.
+  bool loadLoopValue(BinaryOperator *bop);
+  /// Compute what the running function hoists out of loop, on each entry
+  /// to it
+  void enterLoop(Stmt *loop);
   void cast(CastExpr *expr);
   void arraySubscript(ArraySubscriptExpr *arrSubExpr);
+  /// s.f and p->f. A struct, union or array evaluates to its address.
+  void member(MemberExpr *expr);
+  /// The trivial default, copy or move construction of a struct
+  void construct(CXXConstructExpr *expr);
+  /// The implicit assignment operator of a struct
+  void operatorCall(CXXOperatorCallExpr *expr);
+  /// Nodes that only wrap sub, e.g. MaterializeTemporaryExpr
+  void forward(Expr *expr, Expr *sub);
 
   void compoundStmtBegin(CompoundStmt *stmt);
   void compoundStmtEnd();
 
+  size_t frameDepth() const { return mStack.size(); }
+  /// Drop the frames of scopes left early, e.g. by a return
+  void popFramesTo(size_t depth) {
+    while (mStack.size() > depth) {
+      mStack.pop_back();
+    }
+  }
+
   void returnStmt(ReturnStmt *stmt);
 
   void arrayType(VarDecl *vardecl, Expr *init_expr, clang::QualType ty);
 
+  /// The evaluated index-th argument of callexpr, for builtins
+  ObjectV2 getArg(CallExpr *callexpr, unsigned index) const;
+  /// n zeroed slots for a MALLOC at site, or for the host if it is nullptr
+  long *heapAlloc(long n, CallExpr *site = nullptr);
+  void heapFree(long *ptr);
+
+  llvm::raw_ostream &output() { return *mOut; }
+  void setOutput(llvm::raw_ostream &out) { mOut = &out; }
+
+  void setAsyncInput(bool async) { mAsyncInput = async; }
+  void provideInput(long val) { mInput.push_back(val); }
+  /// Call counts and preparation times of the user-defined functions
+  void printFunctionStats(llvm::raw_ostream &os) const;
+  /// The inlined call sites and how often each ran
+  void printInlineReport(llvm::raw_ostream &os) const;
+  /// The hoisted and strength-reduced expressions of each loop
+  void printLoopReport(llvm::raw_ostream &os) const;
+  /// Charge the hardware events between calls and returns to the running
+  /// function. Reading the counters costs a system call per boundary.
+  void setPerfCounters(const PerfCounters *perf) {
+    mPerf = perf;
+    mPerfMark = perf->read();
+  }
+  /// Charge the events since the last call boundary to the running function
+  void chargeCounters();
+  /// Attribute every MALLOC to its call site and the calls leading there
+  void setHeapProfile(HeapProfile *profile) { mHeapProfile = profile; }
+  void printHeapProfile(llvm::raw_ostream &os) const;
+  unsigned long framesPushed() const { return mFramesPushed; }
+  size_t peakFrameDepth() const { return mPeakFrames; }
+  size_t peakHeapBytes() const { return mPeakHeapSlots * sizeof(long); }
+
+  /// Reads the integer for a GET. With asynchronous input and nothing queued
+  /// it returns false, and the run suspends until provideInput.
+  bool readInput(long &val);
+  bool waitingForInput() const { return mWaitingInput; }
+
   long getMainRet() {
     assert(mStack.size() == 2);
     assert(mRetReg.IsRValue());
     return mRetReg.RValue();
   }
 
-  long getPCValue() const {
-    auto *pc = mStack.back().getPC();
-    ObjectV2 obj = mStack.back().getStmtVal(pc);
-    return obj.RValue();
-  }
+  /// The value an evaluated expression was bound to
+  ObjectV2 valueOf(Stmt *stmt) const { return mStack.back().getStmtVal(stmt); }
+
+  /// The loop analyzed on its first execution. Once it is found to be
+  /// parallel, the functions it calls are prepared, so that its workers
+  /// only read the AST and what preparing computed.
+  const ParallelLoop &parallelLoop(OMPParallelForDirective *directive);
+  /// Start an iteration of a parallel loop in a worker
+  void setLoopVar(VarDecl *var, long value);
+
   void AddScopeBeforeCompoundStmt();
+
+private:
+  /// Count the frame just pushed onto mStack
+  void framePushed() {
+    ++mFramesPushed;
+    mPeakFrames = std::max(mPeakFrames, mStack.size());
+  }
+  /// Resolve the declarations of the units to their definitions by name
+  void link(const std::vector<TranslationUnitDecl *> &units);
+  /// Declares the functions of decls and adds their globals to globals, to
+  /// be laid out once they are linked
+  void declare(const std::vector<Decl *> &decls,
+               std::vector<VarDecl *> &globals);
+  /// The Environment whose prepared program this one runs
+  const Environment &shared() const {
+    return mParent != nullptr ? *mParent : *this;
+  }
+  /// The layout of every type of the prepared functions, which running them
+  /// only reads
+  const SlotLayout &layout() const { return shared().mLayout; }
+  /// The key of callee in mFunctions
+  FunctionDecl *functionKey(FunctionDecl *callee) const;
+  /// The declaration a global is bound to in the global frame
+  Decl *linkedDecl(Decl *decl) const {
+    const auto &links = shared().mGlobalLinks;
+    if (links.empty()) {
+      return decl;
+    }
+    auto link = links.find(decl);
+    return link == links.end() ? decl : link->second;
+  }
+  /// Also lays out the types the function uses
+  void prepare(FunctionInfo &info, FunctionDecl *callee);
+  void enterActivation(const FunctionInfo &info, CallExpr *call);
+  /// Picks the calls of info to inline once it is prepared
+  void inlineCalls(FunctionInfo &info);
+  /// Advance the running products of the induction variable update wrote
+  void stepInductions(Stmt *update);
+  /// The slot of decl in the running function, or nullptr if it is not an
+  /// unboxed local
+  const LocalSlot *findLocal(Decl *decl) const;
+  long *localSlot(Decl *decl);
+  /// Zeroed slots freed with the current frame
+  long *newStorage(unsigned slots);
+  /// The handler of an operation of the running function
+  const BinopHandler &handler(Stmt *op) const {
+    return mActivations.back().Function->Handlers.find(op);
+  }
+
+  /// Globals and static locals live in the global frame. Their structs and
+  /// arrays share one data segment, and their initializers are constants
+  /// evaluated once at load time.
+  unsigned dataSlots(QualType ty);
+  void layOutGlobals(const std::vector<VarDecl *> &all);
+  /// Lays out a static local when its declaration is first reached
+  void defineStatic(VarDecl *vardecl);
+  void bindGlobal(VarDecl *vardecl, long *storage);
+  void initGlobal(VarDecl *vardecl);
+  long *globalAddress(const ValueDecl *decl);
+  void storeConstant(long *dst, QualType ty, const APValue &value);
+  long constantAddress(const APValue &value);
+  /// Stores the evaluated elements of an initializer list, or a value, at dst
+  void initAggregate(long *dst, Expr *init);
 };
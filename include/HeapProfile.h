@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+namespace clang {
+class ASTContext;
+class CallExpr;
+} // namespace clang
+
+namespace llvm {
+class raw_ostream;
+} // namespace llvm
+
+/// The MALLOC calls of a run, attributed to their call site and the
+/// interpreted calls that led to it
+class HeapProfile {
+public:
+  /// The MALLOC call first, then the calls of the functions it is in,
+  /// innermost first
+  using CallStack = std::vector<const clang::CallExpr *>;
+  /// Calls kept per stack, so that recursion does not make a site per depth
+  static const unsigned kMaxDepth = 8;
+
+  HeapProfile()
+      : mSites(), mSiteIds(), mBlocks(), mLive(0), mPeak(0),
+        mPeakGeneration(0) {}
+
+  void allocated(const CallStack &stack, const long *ptr, size_t bytes);
+  void freed(const long *ptr);
+
+  /// The sites by peak live bytes, what each held when the whole heap
+  /// peaked, and the blocks never freed grouped by site. Call sites are
+  /// located in the unit among units that holds them.
+  void print(llvm::raw_ostream &os,
+             const std::vector<const clang::ASTContext *> &units) const;
+
+private:
+  struct Site {
+    CallStack Stack;
+    unsigned long Allocs;
+    unsigned long Frees;
+    size_t TotalBytes;
+    size_t LiveBytes;
+    size_t PeakBytes;
+    /// LiveBytes when the whole heap last peaked, saved by the first
+    /// change after the peak, if Generation is mPeakGeneration
+    size_t BytesAtPeak;
+    unsigned long Generation;
+  };
+  struct Block {
+    unsigned Site;
+    size_t Bytes;
+  };
+
+  std::vector<Site> mSites;
+  std::map<CallStack, unsigned> mSiteIds;
+  std::unordered_map<const long *, Block> mBlocks;
+  size_t mLive;
+  size_t mPeak;
+  /// Counts the peaks. A site untouched since the last one still holds
+  /// what it held then.
+  unsigned long mPeakGeneration;
+
+  /// Save what site held at the last peak before it changes
+  void touch(Site &site) {
+    if (site.Generation != mPeakGeneration) {
+      site.BytesAtPeak = site.LiveBytes;
+      site.Generation = mPeakGeneration;
+    }
+  }
+  size_t bytesAtPeak(const Site &site) const {
+    return site.Generation == mPeakGeneration ? site.BytesAtPeak
+                                              : site.LiveBytes;
+  }
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+
+namespace clang {
+class CallExpr;
+class FunctionDecl;
+} // namespace clang
+
+struct InlineOptions {
+  /// Callees of at most this many AST nodes are inlined, 0 disables it
+  unsigned Threshold;
+};
+
+const InlineOptions &getInlineOptions();
+void setInlineOptions(const InlineOptions &options);
+
+/// The calls in the body of function, in source order
+std::vector<clang::CallExpr *> collectCalls(clang::FunctionDecl *function);
+
+/// The number of statements and expressions in the body of function
+unsigned countNodes(clang::FunctionDecl *function);
+
+/// Whether function can reach itself through direct calls. A call of a
+/// function defined in another translation unit counts as reaching it.
+bool isRecursive(clang::FunctionDecl *function);
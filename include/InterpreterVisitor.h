@@ -1,32 +1,146 @@
 #pragma once
 
-#include "clang/AST/EvaluatedExprVisitor.h"
+#include "ParallelFor.h"
+#include "SwitchTable.h"
+#include "clang/AST/Expr.h"
+#include "clang/AST/Stmt.h"
+#include "clang/AST/StmtOpenMP.h"
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+#include <vector>
 using namespace clang;
 class Environment;
-class InterpreterVisitor : public EvaluatedExprVisitor<InterpreterVisitor> {
+
+enum class RunStatus {
+  Finished,
+  /// Waiting in a GET for input, see Environment::provideInput
+  Suspended,
+  /// Stopped for running over its ExecutionBudget. What it printed so far
+  /// stays printed.
+  BudgetExceeded,
+};
+
+/// Limits on a run, checked at loop back-edges and calls only. 0 means no
+/// limit.
+struct ExecutionBudget {
+  /// AST nodes evaluated, see InterpreterVisitor::nodesExecuted
+  unsigned long MaxSteps;
+  /// Wall-clock time since the run started
+  double MaxSeconds;
+};
+
+/// Walks statements with an explicit work stack instead of recursing on the
+/// host C stack. Nested expressions and interpreted calls push Tasks, so the
+/// depth of the interpreted program is bounded by heap memory only.
+class InterpreterVisitor {
 public:
-  explicit InterpreterVisitor(const ASTContext &context, Environment *env)
-      : EvaluatedExprVisitor(context), mEnv(env) {}
+  explicit InterpreterVisitor(Environment *env)
+      : mEnv(env), mWork(), mPaused(false),
+        mSwitchTables(), mNodes(0), mBudget{0, 0}, mStepLimit(~0UL),
+        mSharedSteps(nullptr), mChargedNodes(0), mDeadline(),
+        mClockCountdown(kClockInterval), mOutOfBudget(false) {}
   ~InterpreterVisitor() {}
 
-  void VisitIntegerLiteral(IntegerLiteral *lit);
-  void VisitCharacterLiteral(CharacterLiteral *lit);
-  void VisitBinaryOperator(BinaryOperator *bop);
-  void VisitUnaryOperator(UnaryOperator *uop);
-  void VisitUnaryExprOrTypeTraitExpr(UnaryExprOrTypeTraitExpr *expr);
-  void VisitDeclRefExpr(DeclRefExpr *expr);
-  void VisitArraySubscriptExpr(ArraySubscriptExpr *expr);
-  void VisitParenExpr(ParenExpr *expr);
-  void VisitCallExpr(CallExpr *call);
-  void VisitImplicitCastExpr(ImplicitCastExpr *expr);
-  void VisitCastExpr(CastExpr *expr);
-  void VisitIfStmt(IfStmt *stmt);
-  void VisitWhileStmt(WhileStmt *stmt);
-  void VisitForStmt(ForStmt *stmt);
-  void VisitDeclStmt(DeclStmt *declstmt);
-  void VisitCompoundStmt(CompoundStmt *stmt);
-  void VisitReturnStmt(ReturnStmt *stmt);
+  /// Run a function body until it returns or falls off its end
+  RunStatus Execute(Stmt *body) {
+    Start(body);
+    return Resume();
+  }
+
+  /// Limit the runs started from now on
+  void setBudget(const ExecutionBudget &budget);
+
+  /// Begin running a function body without evaluating anything yet
+  void Start(Stmt *body);
+  /// Continue the started body until it ends or suspends. All pending work
+  /// lives in the work stack, so a suspended run costs no host thread.
+  RunStatus Resume();
+
+  /// AST nodes whose evaluation has begun, for -stats
+  unsigned long nodesExecuted() const { return mNodes; }
 
 private:
+  /// A statement together with how far its evaluation has got
+  struct Task {
+    Stmt *S;
+    unsigned Step;
+    /// Frame depth to restore once a call returns or a loop or switch is
+    /// left early, or which arm of a ?: was taken
+    size_t Mark;
+  };
+
+  /// Push body as a new run, leaving the limits of the budget as they are
+  void Begin(Stmt *body);
+  void Step();
+  /// Push the children of stmt so that they are evaluated left to right.
+  /// Returns false if it has none.
+  bool PushChildren(Stmt *stmt);
+  void Push(Stmt *stmt) { mWork.push_back(Task{stmt, 0, 0}); }
+  /// Push the evaluation of the condition of an if or a loop. Of a
+  /// comparison at its root only the operands are evaluated, and Test
+  /// compares them without binding a value for it.
+  void PushCondition(Expr *cond);
+  /// Whether the condition evaluated by PushCondition holds
+  bool Test(Expr *cond);
+  /// Push the statements of a compound statement from index first on
+  void PushBody(CompoundStmt *stmt, unsigned first);
+  /// Hand a node whose children are evaluated to the Environment
+  void Apply(Stmt *stmt);
+  /// Drop pending work up to the innermost call on a return
+  void Unwind();
+  /// Leave the innermost loop or switch on a break, or start the next
+  /// iteration of the innermost loop on a continue
+  void Jump(bool isContinue);
+  /// Checked at back-edges and calls. The clock is only read every
+  /// kClockInterval checks.
+  bool WithinBudget() {
+    bool steps =
+        mSharedSteps == nullptr ? mNodes <= mStepLimit : ChargeSteps();
+    if (steps && --mClockCountdown != 0) {
+      return true;
+    }
+    return CheckBudget(steps);
+  }
+  bool CheckBudget(bool withinSteps);
+  /// Take the nodes a worker evaluated since its last check out of the
+  /// steps its parallel loop has left. Returns false once they run out.
+  bool ChargeSteps();
+  /// Drop the pending work of a run that went over budget
+  void Abandon();
+
+  void VisitCallExpr(CallExpr *call, unsigned step);
+  void VisitLogicalOperator(BinaryOperator *bop, unsigned step);
+  void VisitConditionalOperator(ConditionalOperator *expr, unsigned step);
+  void VisitIfStmt(IfStmt *stmt, unsigned step);
+  void VisitWhileStmt(WhileStmt *stmt, unsigned step);
+  void VisitForStmt(ForStmt *stmt, unsigned step);
+  void VisitDoStmt(DoStmt *stmt, unsigned step);
+  void VisitSwitchStmt(SwitchStmt *stmt, unsigned step);
+  void VisitParallelFor(OMPParallelForDirective *directive, unsigned step);
+  /// Run trips iterations of loop from begin on the worker pool and wait
+  /// for all of them. The workers draw on the steps this run has left
+  /// together, and once one of them exceeds the budget the others start no
+  /// further iteration.
+  void RunParallel(const ParallelLoop &loop, long begin, long trips);
+  void VisitCompoundStmt(CompoundStmt *stmt, unsigned step);
+  void VisitReturnStmt(ReturnStmt *stmt, unsigned step);
+
   Environment *mEnv;
+  std::vector<Task> mWork;
+  bool mPaused;
+  /// Built on the first execution of each switch
+  std::unordered_map<SwitchStmt *, SwitchTable> mSwitchTables;
+  unsigned long mNodes;
+
+  static const unsigned kClockInterval = 1024;
+  ExecutionBudget mBudget;
+  unsigned long mStepLimit;
+  /// Of a worker of a parallel loop under a step budget, the steps left to
+  /// all the workers of the loop
+  std::atomic<unsigned long> *mSharedSteps;
+  unsigned long mChargedNodes;
+  std::chrono::steady_clock::time_point mDeadline;
+  unsigned mClockCountdown;
+  bool mOutOfBudget;
 };
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <unordered_map>
+
+namespace clang {
+class FunctionDecl;
+class VarDecl;
+} // namespace clang
+
+struct LocalSlot {
+  unsigned Index;
+  unsigned PointerType;
+};
+
+/// The scalar parameters and locals of one function whose address is never
+/// taken. Each activation keeps them in a plain array of slots, read and
+/// written by index, instead of addressable StackFrame entries.
+class LocalSlots {
+public:
+  LocalSlots() : mSlots() {}
+
+  static LocalSlots analyze(clang::FunctionDecl *function);
+
+  /// The slot of decl, or nullptr if it needs addressable storage
+  const LocalSlot *find(const clang::VarDecl *decl) const {
+    auto it = mSlots.find(decl);
+    return it == mSlots.end() ? nullptr : &it->second;
+  }
+
+  unsigned size() const { return mSlots.size(); }
+
+private:
+  std::unordered_map<const clang::VarDecl *, LocalSlot> mSlots;
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "LocalSlots.h"
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace clang {
+class BinaryOperator;
+class Expr;
+class FunctionDecl;
+class Stmt;
+} // namespace clang
+
+class HandlerTable;
+
+struct LoopOptions {
+  /// Hoist invariant expressions out of loops and turn multiplications of
+  /// induction variables into running sums
+  bool Enabled;
+};
+
+const LoopOptions &getLoopOptions();
+void setLoopOptions(const LoopOptions &options);
+
+/// An expression of a loop that reads only literals and locals the loop
+/// never writes. It is computed into a slot each time the loop is entered.
+struct HoistedExpr {
+  clang::BinaryOperator *Expr;
+  LocalSlot Value;
+};
+
+/// i * k in a loop that only steps the local i by constants and never
+/// writes what k reads. The product is computed on entry and advanced by
+/// step * k wherever i is stepped.
+struct ReducedMul {
+  clang::BinaryOperator *Expr;
+  clang::Expr *Factor;
+  unsigned Product;
+  /// Each constant step of i in the loop, with the slot of step * k
+  std::vector<std::pair<long, unsigned>> Deltas;
+};
+
+/// What is computed on entry to a for or while loop
+struct LoopPlan {
+  clang::Stmt *Loop;
+  std::vector<HoistedExpr> Hoisted;
+  std::vector<ReducedMul> Reduced;
+  /// Counted by the thread that prepared the function only
+  mutable unsigned Entries;
+};
+
+/// A running product to advance once an update of its induction variable
+/// has run
+struct InductionStep {
+  unsigned Product;
+  unsigned Delta;
+};
+
+/// The loop plans of one function. Hoisted values and running products
+/// live in slots of its activations after the locals, so reading them
+/// replaces evaluating the expression.
+class LoopInvariants {
+public:
+  LoopInvariants() : mPlans(), mLoops(), mValues(), mSteps(), mSlots(0) {}
+
+  /// Plans the loops of function outermost first, an expression going to
+  /// the outermost loop it is invariant in. Only locals kept in slots are
+  /// considered, as nothing but the function itself can write them. Slots
+  /// are numbered from firstSlot on.
+  static LoopInvariants analyze(clang::FunctionDecl *function,
+                                const LocalSlots &locals, unsigned firstSlot);
+
+  /// The plan of loop, or nullptr if nothing is computed on its entry
+  const LoopPlan *plan(const clang::Stmt *loop) const {
+    if (mLoops.empty()) {
+      return nullptr;
+    }
+    auto it = mLoops.find(loop);
+    return it == mLoops.end() ? nullptr : &mPlans[it->second];
+  }
+
+  /// The slot holding the value of expr, or nullptr if it is evaluated
+  const LocalSlot *value(const clang::Stmt *expr) const {
+    if (mValues.empty()) {
+      return nullptr;
+    }
+    auto it = mValues.find(expr);
+    return it == mValues.end() ? nullptr : &it->second;
+  }
+
+  /// The running products advanced by update, or nullptr
+  const std::vector<InductionStep> *steps(const clang::Stmt *update) const {
+    if (mSteps.empty()) {
+      return nullptr;
+    }
+    auto it = mSteps.find(update);
+    return it == mSteps.end() ? nullptr : &it->second;
+  }
+
+  const std::vector<LoopPlan> &plans() const { return mPlans; }
+  unsigned slots() const { return mSlots; }
+
+private:
+  std::vector<LoopPlan> mPlans;
+  std::unordered_map<const clang::Stmt *, unsigned> mLoops;
+  std::unordered_map<const clang::Stmt *, LocalSlot> mValues;
+  std::unordered_map<const clang::Stmt *, std::vector<InductionStep>> mSteps;
+  unsigned mSlots;
+};
+
+/// The value of an expression LoopInvariants hoisted or reduced, computed
+/// from the slots of an activation of the function with locals and handlers
+long evalInvariant(const clang::Expr *expr, const LocalSlots &locals,
+                   const HandlerTable &handlers, const long *slots);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "ShadowHeap.h"
 #include <string>
 
 class ObjectV2 {
@@ -22,6 +23,7 @@ public:
   long RValue() const {
     long res = rawValue;
     for (int i = 0; i < derefCount; ++i) {
+      checkHeapAccess(res);
       res = *(long *)res;
     }
     return res;
@@ -34,12 +36,14 @@ public:
   ObjectV2 Sub(const ObjectV2 &obj) const;
   ObjectV2 Mul(const ObjectV2 &obj) const;
   ObjectV2 Div(const ObjectV2 &obj) const;
+  ObjectV2 Rem(const ObjectV2 &obj) const;
   ObjectV2 Minus() const;
   ObjectV2 Gt(const ObjectV2 &obj) const;
   ObjectV2 Ge(const ObjectV2 &obj) const;
   ObjectV2 Lt(const ObjectV2 &obj) const;
   ObjectV2 Le(const ObjectV2 &obj) const;
   ObjectV2 Eq(const ObjectV2 &obj) const;
+  ObjectV2 Ne(const ObjectV2 &obj) const;
   ObjectV2 ToRValue() const { return ObjectV2(pointerType, 0, RValue()); }
 
   bool IsRValue() const {
@@ -49,6 +53,8 @@ public:
   // Return LValue
   ObjectV2 Deref() const;
   ObjectV2 Subscript(const ObjectV2 &obj) const;
+  /// The pointer to an lvalue, e.g. &a[i]
+  ObjectV2 AddressOf() const;
   ObjectV2 LValueRef() const {
     return ObjectV2{pointerType, derefCount + 1, (long)&rawValue};
   }
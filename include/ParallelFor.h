@@ -0,0 +1,95 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace clang {
+class ASTContext;
+class Decl;
+class Expr;
+class ForStmt;
+class FunctionDecl;
+class OMPParallelForDirective;
+class VarDecl;
+} // namespace clang
+
+class SlotLayout;
+
+struct ParallelOptions {
+  /// Workers of a `#pragma omp parallel for`, counting the interpreter
+  /// thread. 1 runs every such loop sequentially.
+  unsigned Threads;
+};
+
+const ParallelOptions &getParallelOptions();
+void setParallelOptions(const ParallelOptions &options);
+
+/// A `#pragma omp parallel for` loop in the canonical form
+/// `for (i = Begin; i < End; i += Step)`, with `<=` if Inclusive
+struct ParallelLoop {
+  clang::ForStmt *Loop;
+  clang::VarDecl *Var;
+  clang::Expr *Begin;
+  clang::Expr *End;
+  bool Inclusive;
+  long Step;
+  /// The user functions the body may call
+  std::vector<clang::FunctionDecl *> Callees;
+  /// Why the loop runs sequentially, empty if its iterations may run on
+  /// different threads
+  std::string Rejected;
+};
+
+/// Checks that the iterations of directive are independent as far as the
+/// interpreter is concerned: they must not PRINT, GET, MALLOC or FREE, nor
+/// write a variable declared outside the loop body, directly or in a callee.
+/// Writes through pointers and to array elements are the program's business,
+/// as they are under OpenMP.
+ParallelLoop analyzeParallelFor(clang::OMPParallelForDirective *directive,
+                                const clang::ASTContext &context);
+
+/// Lay out every type decl uses, e.g. a function about to be run or a
+/// translation unit that several threads are about to run, so that they
+/// find the layout caches of ASTContext and layout filled and only ever
+/// read them
+void warmLayouts(clang::Decl *decl, SlotLayout &layout,
+                 const clang::ASTContext &context);
+
+/// Whether the calling thread runs iterations of a parallel loop. Loops
+/// nested in one run sequentially.
+bool inParallelLoop();
+
+/// Threads that wait for parallel loops to run
+class WorkerPool {
+public:
+  /// threads counts the calling thread, which runs the first task
+  explicit WorkerPool(unsigned threads);
+  ~WorkerPool();
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  unsigned size() const { return mThreads.size() + 1; }
+
+  /// Run task(0) to task(size() - 1), one per thread, and return once all
+  /// have finished
+  void run(const std::function<void(unsigned)> &task);
+
+  /// The pool of getParallelOptions().Threads threads, created on first use
+  static WorkerPool &get();
+
+private:
+  void work(unsigned index);
+
+  std::vector<std::thread> mThreads;
+  std::mutex mMutex;
+  std::condition_variable mStart;
+  std::condition_variable mDone;
+  const std::function<void(unsigned)> *mTask;
+  unsigned long mGeneration;
+  unsigned mPending;
+  bool mStop;
+};
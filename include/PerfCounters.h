@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+
+/// Hardware event counts of the calling thread
+struct PerfSample {
+  uint64_t Cycles;
+  uint64_t Instructions;
+  uint64_t BranchMisses;
+  uint64_t CacheMisses;
+
+  PerfSample operator-(const PerfSample &other) const {
+    return PerfSample{Cycles - other.Cycles,
+                      Instructions - other.Instructions,
+                      BranchMisses - other.BranchMisses,
+                      CacheMisses - other.CacheMisses};
+  }
+  PerfSample &operator+=(const PerfSample &other) {
+    Cycles += other.Cycles;
+    Instructions += other.Instructions;
+    BranchMisses += other.BranchMisses;
+    CacheMisses += other.CacheMisses;
+    return *this;
+  }
+};
+
+/// The hardware counters of the calling thread, read through one
+/// perf_event_open group. Without a PMU or the permission to use it, e.g.
+/// in most containers, open fails and every read is zero.
+class PerfCounters {
+public:
+  PerfCounters();
+  ~PerfCounters();
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  /// Start counting. Returns false if no counter could be opened.
+  bool open();
+  bool available() const { return mFds[0] >= 0; }
+  /// Whether the event of field index i of PerfSample is counted
+  bool counts(unsigned i) const { return mFds[i] >= 0; }
+  /// The counts since open, zero for events that are not counted
+  PerfSample read() const;
+
+private:
+  static const unsigned kEvents = 4;
+  int mFds[kEvents];
+};
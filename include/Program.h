@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Environment.h"
+#include "InterpreterVisitor.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include <memory>
+#include <vector>
+
+namespace clang {
+class ASTUnit;
+} // namespace clang
+
+/// A program parsed and initialized once whose functions are then called
+/// any number of times, e.g. as plugins of a host service. main is not run.
+/// Globals keep their values from one call to the next.
+///
+/// A Program is used by one thread at a time. Errors in the interpreted
+/// code end the process, as they do in ast-interpreter.
+class Program {
+public:
+  /// A top-level function the program defines
+  struct Function {
+    FunctionDecl *Definition;
+    unsigned Arity;
+  };
+
+  /// Parses and initializes code. Returns nullptr if it does not compile;
+  /// the diagnostics are printed to stderr.
+  static std::unique_ptr<Program> load(llvm::StringRef code);
+  ~Program();
+  Program(const Program &) = delete;
+  Program &operator=(const Program &) = delete;
+
+  /// The function called name, or nullptr if the program defines none.
+  /// Builtins cannot be looked up. The result stays valid as long as the
+  /// Program.
+  const Function *lookup(llvm::StringRef name);
+
+  /// Call fn with exactly fn.Arity arguments and store what it returns in
+  /// result. Integers are passed as they are, pointers as the address of
+  /// long slots, one per scalar, e.g. from allocate. A call over the budget
+  /// stops early and leaves result alone.
+  RunStatus call(const Function &fn, const std::vector<long> &args,
+                 long &result);
+
+  /// n zeroed slots the program may read, write and FREE
+  long *allocate(long n) { return mEnv.heapAlloc(n); }
+  void release(long *ptr) { mEnv.heapFree(ptr); }
+
+  /// Limit each call from now on
+  void setBudget(const ExecutionBudget &budget) { mVisitor.setBudget(budget); }
+  /// Where PRINT writes to, stderr by default
+  void setOutput(llvm::raw_ostream &out) { mEnv.setOutput(out); }
+
+private:
+  explicit Program(std::unique_ptr<clang::ASTUnit> unit);
+
+  std::unique_ptr<clang::ASTUnit> mUnit;
+  Environment mEnv;
+  InterpreterVisitor mVisitor;
+  llvm::StringMap<Function> mFunctions;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Environment.h"
+#include "InterpreterVisitor.h"
+#include "llvm/ADT/StringRef.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace clang {
+class CompilerInstance;
+class Parser;
+} // namespace clang
+
+/// An interactive session that grows one translation unit snippet by
+/// snippet. Only the new snippet is parsed, into the live ASTContext, and it
+/// runs against the live Environment, so the globals, functions and MALLOC
+/// blocks of earlier snippets persist and a snippet costs the same however
+/// long the session is.
+///
+/// A snippet is either top-level declarations, e.g. globals, structs and
+/// functions, or statements, which run at once as the body of a function.
+class Repl {
+public:
+  Repl();
+  ~Repl();
+  Repl(const Repl &) = delete;
+  Repl &operator=(const Repl &) = delete;
+
+  /// Parse snippet and run its statements. Returns false if it does not
+  /// compile; the diagnostics are printed to stderr and nothing of it runs.
+  bool eval(llvm::StringRef snippet);
+
+  /// Whether text is a whole snippet: its brackets are balanced and it ends
+  /// with ; or }. Otherwise the next line continues it.
+  static bool isComplete(llvm::StringRef text);
+
+  /// Limit each snippet from now on
+  void setBudget(const ExecutionBudget &budget) { mVisitor->setBudget(budget); }
+
+private:
+  /// Whether snippet starts with a declaration specifier or a type name
+  bool isDeclaration(llvm::StringRef snippet) const;
+  /// Parse code after the snippets before it
+  bool parse(const std::string &code, std::vector<Decl *> &decls);
+
+  std::unique_ptr<clang::CompilerInstance> mCompiler;
+  /// Keeps the scope of the translation unit open between snippets
+  std::unique_ptr<clang::Parser> mParser;
+  Environment mEnv;
+  std::unique_ptr<InterpreterVisitor> mVisitor;
+  unsigned mSnippets;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "PerfCounters.h"
+#include <chrono>
+#include <cstddef>
+
+namespace llvm {
+class raw_ostream;
+} // namespace llvm
+
+/// Host allocations: the operator new calls of a binary that counts them,
+/// i.e. of the interpreter itself and of Clang, and the blocks that back the
+/// storage of the interpreted program
+struct HostAllocCount {
+  unsigned long Calls;
+  unsigned long Bytes;
+};
+
+/// Count one host allocation; safe from any thread
+void countHostAlloc(size_t bytes);
+/// Allocations and bytes counted so far by all threads
+HostAllocCount hostAllocCount();
+
+/// Time and host allocations spent in one phase of a run
+struct PhaseStats {
+  double WallSeconds;
+  double CpuSeconds;
+  HostAllocCount Allocs;
+  /// Zero unless hardware counters are read
+  PerfSample Counters;
+};
+
+/// Measures consecutive phases
+class PhaseTimer {
+public:
+  PhaseTimer() : mPerf(nullptr) { restart(); }
+
+  /// Also count the hardware events of each phase
+  void setCounters(const PerfCounters *perf) { mPerf = perf; }
+  void restart();
+  /// The phase since the last restart or lap, and start the next one
+  PhaseStats lap();
+
+private:
+  std::chrono::steady_clock::time_point mWall;
+  double mCpu;
+  HostAllocCount mAllocs;
+  const PerfCounters *mPerf;
+  PerfSample mCounters;
+};
+
+struct RunStats {
+  PhaseStats Parse;
+  PhaseStats Init;
+  PhaseStats Execute;
+  /// Destroying the interpreter and the AST
+  PhaseStats Teardown;
+
+  unsigned long NodesExecuted;
+  unsigned long FramesPushed;
+  size_t PeakFrameDepth;
+  /// Of the MALLOC blocks live at once
+  size_t PeakHeapBytes;
+  /// Whether the phases have hardware counts
+  bool HasCounters;
+};
+
+void printRunStats(const RunStats &stats, llvm::raw_ostream &os);
+void printRunStatsJSON(const RunStats &stats, llvm::raw_ostream &os);
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace clang {
+class Stmt;
+} // namespace clang
+
+/// The MALLOC blocks of a checked run, with a shadow byte per slot telling
+/// whether the slot belongs to a live block. Blocks are bump-allocated from
+/// one reserved range and their addresses are never reused, so the shadow
+/// of a freed block keeps saying so, and every check is a range test and a
+/// byte load.
+///
+/// Freed memory goes back to the kernel a page at a time, but the address
+/// space does not, so a run can allocate capacity bytes in total.
+class ShadowHeap {
+public:
+  explicit ShadowHeap(size_t capacity);
+  ~ShadowHeap();
+  ShadowHeap(const ShadowHeap &) = delete;
+  ShadowHeap &operator=(const ShadowHeap &) = delete;
+
+  /// slots zeroed slots with the header of Storage.h, so slotCount works
+  long *alloc(size_t slots);
+  /// ptr must be the start of a live block
+  void free(long *ptr);
+
+  /// addr may be read or written: it is not inside the range or it is
+  /// inside a live block
+  void check(long addr) const {
+    uintptr_t offset = static_cast<uintptr_t>(addr) - mBase;
+    if (offset < mSize && mShadow[offset / sizeof(long)] < kLive) {
+      report("access to", addr);
+    }
+  }
+  /// check for the n slots from ptr
+  void checkRange(const long *ptr, long n) const;
+
+  /// The statement being evaluated, for reports
+  void setWhere(std::function<const clang::Stmt *()> where) {
+    mWhere = std::move(where);
+  }
+
+private:
+  /// Shadow byte values. Headers and the slots past the top of the heap
+  /// are kUnallocated.
+  enum : uint8_t {
+    kUnallocated,
+    kFreed,
+    kFreedStart,
+    kLive,
+    kLiveStart,
+  };
+
+  [[noreturn]] void report(const char *what, long addr) const;
+
+  uintptr_t mBase;
+  size_t mSize;
+  /// Next free byte of the range
+  size_t mTop;
+  uint8_t *mShadow;
+  std::function<const clang::Stmt *()> mWhere;
+};
+
+/// The heap of the checked run, nullptr unless checking is on
+extern ShadowHeap *gShadowHeap;
+
+/// Check that addr may be read or written, if checking is on
+inline void checkHeapAccess(long addr) {
+  if (gShadowHeap != nullptr) {
+    gShadowHeap->check(addr);
+  }
+}
+
+/// Check the n slots from ptr, if checking is on
+inline void checkHeapRange(const long *ptr, long n) {
+  if (gShadowHeap != nullptr && n > 0) {
+    gShadowHeap->checkRange(ptr, n);
+  }
+}
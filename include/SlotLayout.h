@@ -0,0 +1,54 @@
+#pragma once
+
+#include <unordered_map>
+
+namespace clang {
+class FieldDecl;
+class QualType;
+class RecordDecl;
+} // namespace clang
+
+/// Pointer depth of ty, e.g. 2 for int **
+unsigned getPointerType(clang::QualType ty);
+
+/// Places the fields of structs and unions in the long slots every scalar of
+/// the interpreted program occupies. The offsets follow the order and
+/// overlap ASTContext::getASTRecordLayout gives the fields, and are computed
+/// once per record, so a member access is a base-plus-constant address.
+class SlotLayout {
+public:
+  struct Field {
+    /// Slots before the field within its record
+    unsigned Offset;
+    /// Pointer depth of a scalar field
+    unsigned PointerType;
+    /// A struct, union or array, which evaluates to its address
+    bool Aggregate;
+  };
+
+  SlotLayout() : mRecords(), mFields() {}
+
+  /// Slots a value of type ty occupies, laying out the records it holds
+  unsigned slots(clang::QualType ty);
+  /// The same for a layout that is only read, e.g. by several threads. The
+  /// records ty holds must be laid out already.
+  unsigned slots(clang::QualType ty) const;
+
+  const Field &field(const clang::FieldDecl *decl) {
+    auto it = mFields.find(decl);
+    if (it != mFields.end()) {
+      return it->second;
+    }
+    return layOut(decl);
+  }
+  /// The same for a layout that is only read
+  const Field &field(const clang::FieldDecl *decl) const;
+
+private:
+  unsigned recordSlots(const clang::RecordDecl *decl);
+  const Field &layOut(const clang::FieldDecl *decl);
+
+  /// Size in slots of every record laid out so far
+  std::unordered_map<const clang::RecordDecl *, unsigned> mRecords;
+  std::unordered_map<const clang::FieldDecl *, Field> mFields;
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+
+/// How arrays and MALLOC blocks of the interpreted program are allocated
+struct StorageOptions {
+  /// Blocks of at least this many bytes are anonymous mappings, which the
+  /// kernel zeroes page by page on first touch, so untouched pages cost
+  /// nothing. Smaller blocks come from calloc.
+  size_t MmapThreshold;
+  /// Ask for transparent huge pages on mapped blocks
+  bool HugePages;
+};
+
+const StorageOptions &getStorageOptions();
+void setStorageOptions(const StorageOptions &options);
+
+/// Zeroed storage for slots longs. Never returns nullptr.
+long *allocSlots(size_t slots);
+/// Release storage from allocSlots
+void freeSlots(long *ptr);
+/// The number of slots ptr was allocated with
+size_t slotCount(const long *ptr);
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+namespace clang {
+class ASTContext;
+class SwitchStmt;
+} // namespace clang
+
+/// Maps the value of a switch condition to the statement of the switch body
+/// that execution continues at. Dense case labels become a table indexed by
+/// value, sparse ones a sorted list searched by bisection.
+class SwitchTable {
+public:
+  static const unsigned kNoTarget = ~0u;
+
+  /// Collects the case labels of stmt once. They must label statements of
+  /// the switch body itself, possibly through each other as in
+  /// `case 1: case 2:`, rather than statements nested deeper.
+  static SwitchTable build(clang::SwitchStmt *stmt,
+                           const clang::ASTContext &context);
+
+  /// Index of the body statement to continue at, or kNoTarget
+  unsigned lookup(long value) const {
+    if (mDense) {
+      unsigned long offset =
+          static_cast<unsigned long>(value) - static_cast<unsigned long>(mMin);
+      return offset < mTable.size() ? mTable[offset] : mDefault;
+    }
+    auto it = std::upper_bound(
+        mRanges.begin(), mRanges.end(), value,
+        [](long v, const Range &range) { return v < range.Lo; });
+    if (it != mRanges.begin() && value <= (--it)->Hi) {
+      return it->Target;
+    }
+    return mDefault;
+  }
+
+  bool isDense() const { return mDense; }
+
+private:
+  /// case Lo ... Hi, a single label if Lo == Hi
+  struct Range {
+    long Lo;
+    long Hi;
+    unsigned Target;
+  };
+
+  SwitchTable()
+      : mDense(false), mMin(0), mTable(), mRanges(), mDefault(kNoTarget) {}
+
+  bool mDense;
+  long mMin;
+  std::vector<unsigned> mTable;
+  /// sorted by Lo
+  std::vector<Range> mRanges;
+  unsigned mDefault;
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "ObjectV2.h"
+#include <csignal>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+namespace clang {
+class ASTContext;
+class Stmt;
+} // namespace clang
+
+namespace llvm {
+class raw_ostream;
+} // namespace llvm
+
+/// An evaluated expression and its value
+struct TraceEntry {
+  const clang::Stmt *S;
+  ObjectV2 Value;
+};
+
+/// The last evaluated expressions, kept for a post-mortem dump. The ring is
+/// allocated once and only ever written by the interpreter thread, so a
+/// record is a single store that takes no lock.
+class TraceRing {
+public:
+  /// capacity is rounded up to a power of two
+  explicit TraceRing(size_t capacity);
+  ~TraceRing();
+  TraceRing(const TraceRing &) = delete;
+  TraceRing &operator=(const TraceRing &) = delete;
+
+  void record(const clang::Stmt *stmt, const ObjectV2 &value) {
+    mEntries[mNext++ & mMask] = TraceEntry{stmt, value};
+  }
+
+  /// Oldest entry first
+  void dump(llvm::raw_ostream &os,
+            const std::vector<const clang::ASTContext *> &units) const;
+
+private:
+  TraceEntry *mEntries;
+  size_t mMask;
+  size_t mNext;
+};
+
+/// The ring of the interpreter thread, nullptr unless tracing is on. The
+/// workers of parallel loops do not trace.
+extern thread_local TraceRing *gTraceRing;
+/// Set by SIGUSR1, the interpreter dumps the trace at its next step
+extern volatile std::sig_atomic_t gTraceRequested;
+
+/// The unit among units whose AST holds stmt, or the first one. A program
+/// of several files has a context, and a SourceManager, per file.
+const clang::ASTContext &
+unitOf(const std::vector<const clang::ASTContext *> &units,
+       const clang::Stmt *stmt);
+
+/// Keep the last capacity evaluated expressions of the program made of
+/// units and dump them on SIGUSR1. A capacity of 0 leaves tracing off.
+void startTrace(size_t capacity,
+                const std::vector<const clang::ASTContext *> &units);
+
+inline void traceValue(const clang::Stmt *stmt, const ObjectV2 &value) {
+  if (gTraceRing != nullptr) {
+    gTraceRing->record(stmt, value);
+  }
+}
+
+/// The statement the interpreter thread is at, as last set by
+/// StackFrame::setPC, for errors raised below the statement level
+extern thread_local const clang::Stmt *gCurrentPC;
+
+/// Print the trace, if tracing is on
+void dumpTrace(llvm::raw_ostream &os);
+
+/// Thrown by fatal, instead of exiting, on a thread that called
+/// throwOnFatal. what() tells the statement being evaluated.
+class FatalError : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+/// Make fatal throw a FatalError on the calling thread, or exit again, for
+/// a server that must end only the session at fault
+void throwOnFatal(bool on);
+bool fatalThrows();
+
+/// Give up on the program after an error was printed: report the statement
+/// pc being evaluated, which may be nullptr, dump the trace and exit, or
+/// throw after throwOnFatal
+[[noreturn]] void fatal(const clang::Stmt *pc);
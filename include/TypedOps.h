@@ -0,0 +1,69 @@
+#pragma once
+
+#include "ObjectV2.h"
+#include "clang/AST/OperationKinds.h"
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+namespace clang {
+class FunctionDecl;
+class QualType;
+class Stmt;
+} // namespace clang
+
+class SlotLayout;
+
+/// An arithmetic operator, comparison or subscript specialized for the
+/// static types of its operands. Clang has type-checked the operation, so
+/// a handler never looks at the pointerType of its operands.
+struct BinopHandler {
+  using Fn = ObjectV2 (*)(const BinopHandler &self, const ObjectV2 &l,
+                          const ObjectV2 &r);
+
+  Fn Apply;
+  /// Bytes a pointer moves per unit of the integer operand, or the size of
+  /// the pointee for a pointer difference
+  long Scale;
+  /// Pointer depth of the result
+  unsigned PointerType;
+
+  ObjectV2 operator()(const ObjectV2 &l, const ObjectV2 &r) const {
+    return Apply(*this, l, r);
+  }
+};
+
+/// The handler for l op r, where result is the type the value is computed
+/// in, e.g. the computation result type of a compound assignment. An
+/// operator the interpreter does not implement is reported when the handler
+/// is applied, so code that never runs may use it.
+BinopHandler selectBinop(clang::BinaryOperatorKind op, clang::QualType lhs,
+                         clang::QualType rhs, clang::QualType result,
+                         SlotLayout &layout);
+
+/// The handler for base[index] with base a pointer to element. A struct or
+/// array element evaluates to its address, anything else to an lvalue.
+BinopHandler selectSubscript(clang::QualType element, SlotLayout &layout);
+
+/// The handlers of the arithmetic, comparison, ++, -- and subscript
+/// operations of one function, selected when it is prepared. Kept sorted by
+/// address in a flat array, so a lookup is a binary search over contiguous
+/// memory instead of a hash and a bucket chain.
+class HandlerTable {
+public:
+  HandlerTable() : mOps(), mHandlers() {}
+
+  static HandlerTable build(clang::FunctionDecl *function, SlotLayout &layout);
+
+  /// The handler of op, an operation of the function
+  const BinopHandler &find(const clang::Stmt *op) const {
+    auto it = std::lower_bound(mOps.begin(), mOps.end(), op);
+    assert(it != mOps.end() && *it == op);
+    return mHandlers[it - mOps.begin()];
+  }
+
+private:
+  std::vector<const clang::Stmt *> mOps;
+  /// In the order of mOps
+  std::vector<BinopHandler> mHandlers;
+};
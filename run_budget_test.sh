@@ -0,0 +1,24 @@
+#!/bin/bash
+# Runs programs that cannot finish within -max-steps. Each must stop with
+# exit status 3, keeping what it printed before.
+
+function validate() {
+	expected=$1
+	shift
+	output="$(./build/ast-interpreter "$@" 2>/dev/null)"
+	status=$?
+	if [ $status != 3 ]; then
+		echo "error: $*: expected exit status 3, actual $status"
+		exit 1
+	fi
+	if [ "$output" != "$expected" ]; then
+		echo "error: $*: expected '$expected', actual '$output'"
+		exit 1
+	fi
+}
+
+validate 123 -max-steps=100000 test/budget/loop.c
+# the parallel loop takes far more steps in all than the budget, but each
+# of the four workers far fewer
+validate 7 -max-steps=2000000 -omp-threads=4 test/budget/parallel.c
+echo 'success'
@@ -0,0 +1,30 @@
+#!/bin/bash
+# Runs the programs of test/checkheap under -check-heap. Each must stop with
+# the report of its error and the line it happened on.
+
+function invalid() {
+	output="$(./build/ast-interpreter -check-heap test/checkheap/$1.c 2>&1)"
+	if [ $? == 0 ]; then
+		echo "error: $1: not stopped"
+		exit 1
+	fi
+	if [[ "$output" != *"heap check: $2"* ]] ||
+		[[ "$output" != *"while evaluating test/checkheap/$1.c:$3:"* ]]; then
+		echo "error: $1: expected '$2' at line $3, actual '$output'"
+		exit 1
+	fi
+}
+
+invalid double_free 'FREE of a freed block' 9
+invalid free_middle 'FREE of the middle of a block' 8
+invalid free_global 'FREE of a non-heap address' 8
+invalid read_after_free 'access to a freed block' 10
+invalid write_after_free 'access to a freed block' 9
+
+# a valid program runs as it does unchecked
+output="$(./build/ast-interpreter -check-heap test/test23.c 2>&1)"
+if [ $? != 0 ] || [ "$output" != 2442 ]; then
+	echo "error: test23: expected '2442', actual '$output'"
+	exit 1
+fi
+echo 'success'
@@ -0,0 +1,20 @@
+#!/bin/bash
+# Links the pairs of test/duplicate, which define the same external name
+# twice. Each must stop with a report of that name.
+
+function duplicate() {
+	output="$(./build/ast-interpreter test/duplicate/$1.c \
+		test/duplicate/$1_other.c 2>&1)"
+	if [ $? == 0 ]; then
+		echo "error: $1: not stopped"
+		exit 1
+	fi
+	if [[ "$output" != *"multiple definition of $2"* ]]; then
+		echo "error: $1: expected a second $2, actual '$output'"
+		exit 1
+	fi
+}
+
+duplicate function twice
+duplicate global g
+echo 'success'
@@ -0,0 +1,12 @@
+#!/bin/bash
+# Feeds test/repl/session.c to -repl one line at a time. Globals and heap
+# blocks outlive the snippet that made them, and a snippet that does not
+# compile runs none of its statements.
+
+expected='4240'
+actual="$(./build/ast-interpreter -repl < test/repl/session.c 2>/dev/null)"
+if [ "$actual" != "$expected" ]; then
+	echo "error: expected '$expected', actual '$actual'"
+	exit 1
+fi
+echo 'success'
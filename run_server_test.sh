@@ -0,0 +1,57 @@
+#!/bin/bash
+# Runs many concurrent sessions of test/server/sum.c against one server, then
+# checks that a session dividing by zero ends alone in test/server/divide.c.
+
+port=${PORT:-18462}
+sessions=${SESSIONS:-200}
+
+./build/ast-interpreter-server $port test/server/sum.c 2 &
+server=$!
+trap 'kill $server' EXIT
+sleep 1
+
+function session() {
+	exec 3<>/dev/tcp/127.0.0.1/$port
+	# answer the prompts one at a time so the session suspends in between
+	for v in 3 $1 $2 $3; do
+		echo $v >&3
+		sleep 0.1
+	done
+	output="$(cat <&3)"
+	exec 3<&-
+	expected=$(($1 + $2 + $3))
+	if [ "${output##*: }" != "$expected" ]; then
+		echo "error: expected $expected, actual '$output'"
+		exit 1
+	fi
+}
+
+pids=()
+for i in $(seq $sessions); do
+	session $i $((i * 2)) 7 &
+	pids+=($!)
+done
+for pid in ${pids[@]}; do
+	wait $pid || exit 1
+done
+
+kill $server
+./build/ast-interpreter-server $port test/server/divide.c 2 &
+server=$!
+sleep 1
+
+function divide() {
+	exec 3<>/dev/tcp/127.0.0.1/$port
+	echo $1 >&3
+	output="$(cat <&3)"
+	exec 3<&-
+	if [[ "$output" != *"$2"* ]]; then
+		echo "error: expected '$2', actual '$output'"
+		exit 1
+	fi
+}
+
+divide 0 'error: while evaluating'
+# the server is still up for the next session
+divide 4 25
+echo 'success'
@@ -2,7 +2,9 @@
 
 function validate() {
 	expected="$(cat test/build/$1.output)"
-	actual="$(./build/ast-interpreter "$(cat test/$1.c)" 2>&1)"
+	# the other translation units of the test, if any
+	units=$(find test/$1 -name '*.c' 2>/dev/null | sort)
+	actual="$(./build/ast-interpreter test/$1.c $units 2>&1)"
 
 	if [ $expected == $actual ]; then
 	echo 'success'
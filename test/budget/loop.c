@@ -0,0 +1,14 @@
+extern void PRINT(int);
+
+int main() {
+	int i;
+	PRINT(1);
+	PRINT(2);
+	PRINT(3);
+	i = 0;
+	while (1) {
+		i = i + 1;
+	}
+	PRINT(i);
+	return 0;
+}
@@ -0,0 +1,18 @@
+extern void PRINT(int);
+
+int a[4000];
+
+int main() {
+	int i;
+	PRINT(7);
+#pragma omp parallel for
+	for (int k = 0; k < 4000; k++) {
+		for (int c = 0; c < 100; c++) {
+			a[k] = a[k] + c;
+		}
+	}
+	for (i = 0; i < 4000; i++) {
+		PRINT(a[i]);
+	}
+	return 0;
+}
@@ -0,0 +1,10 @@
+extern void *MALLOC(int);
+extern void FREE(void *);
+extern void PRINT(int);
+
+int a[4];
+
+int main() {
+	FREE(a);
+	return 0;
+}
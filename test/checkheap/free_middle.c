@@ -0,0 +1,10 @@
+extern void *MALLOC(int);
+extern void FREE(void *);
+extern void PRINT(int);
+
+int main() {
+	int *p;
+	p = (int *)MALLOC(4 * sizeof(int));
+	FREE(p + 2);
+	return 0;
+}
@@ -0,0 +1,12 @@
+extern void *MALLOC(int);
+extern void FREE(void *);
+extern void PRINT(int);
+
+int main() {
+	int *p;
+	p = (int *)MALLOC(4 * sizeof(int));
+	p[1] = 5;
+	FREE(p);
+	PRINT(p[1]);
+	return 0;
+}
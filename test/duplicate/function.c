@@ -0,0 +1,9 @@
+extern void PRINT(int);
+int twice(int n);
+
+int main() {
+	PRINT(twice(2));
+	return 0;
+}
+
+int twice(int n) { return n + n; }
@@ -0,0 +1 @@
+int twice(int n) { return 2 * n; }
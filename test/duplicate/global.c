@@ -0,0 +1,8 @@
+extern void PRINT(int);
+int g = 1;
+int h;
+
+int main() {
+	PRINT(g + h);
+	return 0;
+}
@@ -0,0 +1,3 @@
+/* a tentative definition of h is fine, a second initialized g is not */
+int h;
+int g = 2;
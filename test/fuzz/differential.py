@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+"""Differential and throughput check of the interpreter against gcc.
+
+Each random program from genprog.py is built natively with gcc and
+test/libtest.c, like test/Makefile does for the checked-in tests, and run
+both ways. The outputs must match. The time of each run is written to a CSV
+file so that a change to the interpreter can be checked for correctness and
+speed over thousands of programs.
+
+usage: differential.py [-n COUNT] [--seed FIRST] [--interpreter PATH]
+                       [--work DIR] [--csv FILE] [-- INTERPRETER ARGS...]
+"""
+
+import argparse
+import csv
+import math
+import os
+import subprocess
+import sys
+import time
+
+import genprog
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+LIBTEST = os.path.join(HERE, '..', 'libtest.c')
+
+
+def timed(command, timeout):
+    start = time.perf_counter()
+    try:
+        result = subprocess.run(command, stdout=subprocess.PIPE,
+                                stderr=subprocess.STDOUT, timeout=timeout)
+    except subprocess.TimeoutExpired:
+        return None, timeout
+    return result, time.perf_counter() - start
+
+
+def check(seed, args, libtest):
+    """Returns (status, native seconds, interpreter seconds)"""
+    source = genprog.generate(seed)
+    path = os.path.join(args.work, 'prog%d.c' % seed)
+    binary = os.path.join(args.work, 'prog%d' % seed)
+    with open(path, 'w') as f:
+        f.write(source)
+    subprocess.run(['gcc', '-w', path, libtest, '-o', binary], check=True)
+    native, native_time = timed([binary], args.timeout)
+    interp, interp_time = timed([args.interpreter] + args.interpreter_args +
+                                [path], args.timeout)
+    os.remove(binary)
+    if native is None:
+        # a generator bug, the program itself does not end
+        status = 'native-timeout'
+    elif interp is None:
+        status = 'timeout'
+    elif interp.returncode != 0:
+        status = 'crash'
+    elif interp.stdout != native.stdout:
+        status = 'mismatch'
+    else:
+        status = 'ok'
+    if status == 'ok' and not args.keep:
+        os.remove(path)
+    return status, native_time, interp_time
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('-n', '--count', type=int, default=100)
+    parser.add_argument('--seed', type=int, default=0,
+                        help='seed of the first program')
+    parser.add_argument('--interpreter', default='./build/ast-interpreter')
+    parser.add_argument('--work', default='fuzz-work',
+                        help='where programs that fail are kept')
+    parser.add_argument('--csv', default=None,
+                        help='write seed, status and times of every program')
+    parser.add_argument('--timeout', type=float, default=20)
+    parser.add_argument('--keep', action='store_true',
+                        help='keep the programs that pass too')
+    parser.add_argument('interpreter_args', nargs='*')
+    args = parser.parse_args()
+
+    os.makedirs(args.work, exist_ok=True)
+    libtest = os.path.join(args.work, 'libtest.o')
+    subprocess.run(['gcc', '-c', LIBTEST, '-o', libtest], check=True)
+
+    rows = []
+    failures = 0
+    ratios = []
+    for seed in range(args.seed, args.seed + args.count):
+        status, native_time, interp_time = check(seed, args, libtest)
+        rows.append((seed, status, native_time, interp_time))
+        if status == 'ok':
+            ratios.append(interp_time / max(native_time, 1e-6))
+        else:
+            failures += 1
+            print('seed %d: %s, kept in %s' %
+                  (seed, status, os.path.join(args.work, 'prog%d.c' % seed)))
+            sys.stdout.flush()
+
+    if args.csv:
+        with open(args.csv, 'w', newline='') as f:
+            writer = csv.writer(f)
+            writer.writerow(['seed', 'status', 'native_s', 'interpreter_s'])
+            for seed, status, native_time, interp_time in rows:
+                writer.writerow([seed, status, '%.6f' % native_time,
+                                 '%.6f' % interp_time])
+
+    total_native = sum(row[2] for row in rows)
+    total_interp = sum(row[3] for row in rows)
+    print('%d programs, %d failed' % (len(rows), failures))
+    print('native %.3fs, interpreter %.3fs' % (total_native, total_interp))
+    if ratios:
+        geomean = math.exp(sum(math.log(r) for r in ratios) / len(ratios))
+        print('interpreter / native: geometric mean %.1fx' % geomean)
+    return 1 if failures else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,327 @@
+#!/usr/bin/env python3
+"""Emit a random C program inside the subset the interpreter supports.
+
+The program is deterministic and free of undefined behaviour, so its output
+must match a native gcc build linked with test/libtest.c:
+
+  * every arithmetic result is reduced modulo a small prime, so nothing
+    overflows a 32-bit int natively or differs from the interpreter's longs
+  * divisors are kept in [2, 14] and array indices are wrapped into bounds
+  * loops have constant trip counts and recursion a bounded depth
+  * every MALLOC block is initialised before it is read and freed once
+
+It also avoids what Clang warns about by default, e.g. self-comparisons and
+constant operands of && and ||, as the warnings would end up in the output.
+
+usage: genprog.py [seed] > prog.c
+"""
+
+import random
+import sys
+
+MOD = 997
+
+
+class Scope:
+    def __init__(self, parent=None):
+        self.parent = parent
+        self.ints = []
+        # loop counters, read but never assigned so every loop ends
+        self.counters = []
+        # name -> length
+        self.arrays = {}
+
+    def all_ints(self):
+        names = list(self.ints)
+        if self.parent is not None:
+            names += self.parent.all_ints()
+        return names
+
+    def all_readable(self):
+        names = self.ints + self.counters
+        if self.parent is not None:
+            names += self.parent.all_readable()
+        return names
+
+    def all_arrays(self):
+        arrays = dict(self.parent.all_arrays()) if self.parent else {}
+        arrays.update(self.arrays)
+        return arrays
+
+
+class Generator:
+    def __init__(self, rng):
+        self.rng = rng
+        self.lines = []
+        self.indent = 0
+        self.counter = 0
+        # (name, number of int parameters) of the functions defined so far
+        self.functions = []
+        # loop nesting of the statement being generated
+        self.loop_depth = 0
+        # calls left in the function being generated. Calls only happen
+        # outside loops and a few times per function, so the work of a
+        # program stays small however deep its call graph is.
+        self.calls_left = 0
+
+    def fresh(self, prefix):
+        self.counter += 1
+        return '%s%d' % (prefix, self.counter)
+
+    def emit(self, line):
+        self.lines.append('\t' * self.indent + line)
+
+    # expressions -----------------------------------------------------------
+
+    def index(self, expr, length):
+        return '((%s) %% %d + %d) %% %d' % (expr, length, length, length)
+
+    def leaf(self, scope):
+        rng = self.rng
+        ints = scope.all_readable()
+        arrays = scope.all_arrays()
+        choice = rng.random()
+        if ints and choice < 0.5:
+            return rng.choice(ints)
+        if arrays and choice < 0.7:
+            name = rng.choice(sorted(arrays))
+            idx = self.index(self.expr(scope, 1), arrays[name])
+            if rng.random() < 0.5:
+                return '%s[%s]' % (name, idx)
+            return '*(%s + %s)' % (name, idx)
+        value = rng.randint(-20, 100)
+        return str(value) if value >= 0 else '(%d)' % value
+
+    def expr(self, scope, depth=3):
+        rng = self.rng
+        if depth <= 0 or rng.random() < 0.3:
+            return self.leaf(scope)
+        kind = rng.random()
+        lhs = self.expr(scope, depth - 1)
+        rhs = self.expr(scope, depth - 1)
+        if kind < 0.45:
+            op = rng.choice(['+', '-', '*'])
+            return '((%s %s %s) %% %d)' % (lhs, op, rhs, MOD)
+        if kind < 0.55:
+            return '(%s / (%s %% 7 + 8))' % (lhs, rhs)
+        if kind < 0.65:
+            return '(%s %% (%s %% 7 + 8))' % (lhs, rhs)
+        if kind < 0.8:
+            if lhs == rhs:
+                rhs = str(rng.randint(0, 100))
+            op = rng.choice(['<', '<=', '>', '>=', '==', '!='])
+            return '(%s %s %s)' % (lhs, op, rhs)
+        if kind < 0.85:
+            op = rng.choice(['&&', '||'])
+            return '((%s != 0) %s (%s != 0))' % (lhs, op, rhs)
+        if kind < 0.9:
+            return '(%s ? %s : %s)' % (self.expr(scope, 1), lhs, rhs)
+        if self.functions and self.loop_depth == 0 and self.calls_left > 0:
+            self.calls_left -= 1
+            name, params = rng.choice(self.functions)
+            args = ', '.join(self.expr(scope, 1) for _ in range(params))
+            return '%s(%s)' % (name, args)
+        return '(0 - %s)' % lhs
+
+    # statements ------------------------------------------------------------
+
+    def assign(self, scope):
+        rng = self.rng
+        ints = scope.all_ints()
+        arrays = scope.all_arrays()
+        value = self.expr(scope)
+        if ints and value in ints:
+            value = '(%s + 1) %% %d' % (value, MOD)
+        if arrays and (not ints or rng.random() < 0.3):
+            name = rng.choice(sorted(arrays))
+            idx = self.index(self.expr(scope, 1), arrays[name])
+            self.emit('%s[%s] = %s;' % (name, idx, value))
+        elif ints:
+            self.emit('%s = %s;' % (rng.choice(ints), value))
+
+    def block(self, scope, statements):
+        inner = Scope(scope)
+        self.indent += 1
+        for _ in range(statements):
+            self.statement(inner)
+        self.indent -= 1
+
+    def statement(self, scope):
+        rng = self.rng
+        kind = rng.random()
+        nested = self.indent < 4
+        if kind < 0.35 or not nested:
+            self.assign(scope)
+        elif kind < 0.5:
+            self.emit('PRINT(%s);' % self.expr(scope))
+        elif kind < 0.65:
+            self.emit('if (%s) {' % self.expr(scope, 2))
+            self.block(scope, rng.randint(1, 3))
+            if rng.random() < 0.5:
+                self.emit('} else {')
+                self.block(scope, rng.randint(1, 3))
+            self.emit('}')
+        elif kind < 0.8 and self.loop_depth < 3:
+            self.loop(scope)
+        elif kind < 0.9:
+            self.pointer_walk(scope)
+        else:
+            self.heap_block(scope)
+
+    def loop(self, scope):
+        rng = self.rng
+        counter = self.fresh('i')
+        trips = rng.randint(1, 12)
+        self.loop_depth += 1
+        shape = rng.random()
+        if shape < 0.6:
+            self.emit('for (int %s = 0; %s < %d; %s++) {' %
+                      (counter, counter, trips, counter))
+            inner = Scope(scope)
+            inner.counters.append(counter)
+            self.indent += 1
+            for _ in range(rng.randint(1, 3)):
+                self.statement(inner)
+            self.indent -= 1
+            self.emit('}')
+        else:
+            self.emit('int %s;' % counter)
+            self.emit('%s = 0;' % counter)
+            self.emit('while (%s < %d) {' % (counter, trips))
+            inner = Scope(scope)
+            inner.counters.append(counter)
+            self.indent += 1
+            for _ in range(rng.randint(1, 3)):
+                self.statement(inner)
+            self.emit('%s = %s + 1;' % (counter, counter))
+            self.indent -= 1
+            self.emit('}')
+        self.loop_depth -= 1
+
+    def pointer_walk(self, scope):
+        arrays = scope.all_arrays()
+        if not arrays:
+            return self.assign(scope)
+        name = self.rng.choice(sorted(arrays))
+        length = arrays[name]
+        ptr = self.fresh('p')
+        self.emit('int *%s;' % ptr)
+        self.emit('%s = %s;' % (ptr, name))
+        self.emit('while (%s < %s + %d) {' % (ptr, name, length))
+        self.indent += 1
+        self.emit('*%s = (*%s + %s) %% %d;' %
+                  (ptr, ptr, self.leaf(scope), MOD))
+        self.emit('%s = %s + 1;' % (ptr, ptr))
+        self.indent -= 1
+        self.emit('}')
+
+    def heap_block(self, scope):
+        rng = self.rng
+        name = self.fresh('m')
+        length = rng.randint(1, 16)
+        self.emit('int *%s;' % name)
+        self.emit('%s = (int *)MALLOC(sizeof(int) * %d);' % (name, length))
+        counter = self.fresh('i')
+        self.emit('for (int %s = 0; %s < %d; %s++) {' %
+                  (counter, counter, length, counter))
+        self.indent += 1
+        self.loop_depth += 1
+        self.emit('%s[%s] = %s;' % (name, counter, self.expr(scope, 2)))
+        self.loop_depth -= 1
+        self.indent -= 1
+        self.emit('}')
+        inner = Scope(scope)
+        inner.arrays[name] = length
+        for _ in range(rng.randint(1, 3)):
+            self.assign(inner)
+        self.emit('PRINT(%s[%d]);' % (name, rng.randrange(length)))
+        self.emit('FREE(%s);' % name)
+
+    # functions -------------------------------------------------------------
+
+    def function(self):
+        rng = self.rng
+        name = self.fresh('f')
+        params = rng.randint(1, 3)
+        scope = Scope()
+        names = ['a%d' % i for i in range(params)]
+        scope.ints.extend(names)
+        self.emit('int %s(%s) {' %
+                  (name, ', '.join('int ' + n for n in names)))
+        self.indent += 1
+        self.calls_left = 2
+        self.locals(scope)
+        for _ in range(rng.randint(1, 4)):
+            self.statement(scope)
+        self.emit('return %s;' % self.expr(scope))
+        self.indent -= 1
+        self.emit('}')
+        self.emit('')
+        self.functions.append((name, params))
+
+    def recursive(self):
+        name = self.fresh('r')
+        self.emit('int %s(int n, int a) {' % name)
+        self.emit('\tif (n <= 0) {')
+        self.emit('\t\treturn a;')
+        self.emit('\t}')
+        self.emit('\treturn %s(n - 1, (a * %d + n) %% %d);' %
+                  (name, self.rng.randint(2, 9), MOD))
+        self.emit('}')
+        self.emit('')
+        self.recursives.append(name)
+
+    def locals(self, scope):
+        rng = self.rng
+        for _ in range(rng.randint(1, 4)):
+            name = self.fresh('x')
+            self.emit('int %s;' % name)
+            self.emit('%s = %d;' % (name, rng.randint(-10, 50)))
+            scope.ints.append(name)
+        for _ in range(rng.randint(0, 2)):
+            name = self.fresh('arr')
+            length = rng.randint(1, 10)
+            self.emit('int %s[%d];' % (name, length))
+            counter = self.fresh('i')
+            self.emit('for (int %s = 0; %s < %d; %s++) {' %
+                      (counter, counter, length, counter))
+            self.emit('\t%s[%s] = %s * %d;' %
+                      (name, counter, counter, rng.randint(1, 9)))
+            self.emit('}')
+            scope.arrays[name] = length
+
+    def program(self):
+        self.recursives = []
+        self.emit('extern int GET();')
+        self.emit('extern void *MALLOC(int);')
+        self.emit('extern void FREE(void *);')
+        self.emit('extern void PRINT(int);')
+        self.emit('')
+        for _ in range(self.rng.randint(0, 2)):
+            self.recursive()
+        for _ in range(self.rng.randint(0, 4)):
+            self.function()
+        self.emit('int main() {')
+        self.indent += 1
+        self.calls_left = 6
+        scope = Scope()
+        self.locals(scope)
+        for name in self.recursives:
+            self.emit('PRINT(%s(%d, %d));' %
+                      (name, self.rng.randint(0, 30), self.rng.randint(0, 9)))
+        for _ in range(self.rng.randint(3, 10)):
+            self.statement(scope)
+        for name in scope.ints:
+            self.emit('PRINT(%s);' % name)
+        self.emit('return 0;')
+        self.indent -= 1
+        self.emit('}')
+        return '\n'.join(self.lines) + '\n'
+
+
+def generate(seed):
+    return Generator(random.Random(seed)).program()
+
+
+if __name__ == '__main__':
+    sys.stdout.write(generate(int(sys.argv[1]) if len(sys.argv) > 1 else 0))
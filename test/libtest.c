@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 int GET() {
 	int a;
@@ -17,4 +18,29 @@ void FREE(void * ptr) {
 
 void PRINT(int n) {
 	printf("%d", n);
+}
+
+void MEMCPY(int * dst, int * src, int n) {
+	memmove(dst, src, n * sizeof(int));
+}
+
+void MEMSET(int * dst, int value, int n) {
+	for (int i = 0; i < n; i++)
+		dst[i] = value;
+}
+
+int MEMCMP(int * a, int * b, int n) {
+	for (int i = 0; i < n; i++)
+		if (a[i] != b[i])
+			return a[i] < b[i] ? -1 : 1;
+	return 0;
+}
+
+static int compare_int(const void * a, const void * b) {
+	int x = *(const int *)a, y = *(const int *)b;
+	return (x > y) - (x < y);
+}
+
+void SORT(int * arr, int n) {
+	qsort(arr, n, sizeof(int), compare_int);
 }
\ No newline at end of file
@@ -0,0 +1,20 @@
+extern void PRINT(int);
+
+extern int t[];
+extern int scale;
+extern int *last;
+int sum(int n);
+
+int *first = t;
+
+int main() {
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		t[i] = i * scale;
+	}
+	PRINT(sum(4));
+	PRINT(*last);
+	PRINT(first[2]);
+	return 0;
+}
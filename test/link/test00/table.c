@@ -0,0 +1,14 @@
+int t[8];
+int scale = 3;
+int *last = &t[3];
+
+int sum(int n) {
+	int i;
+	int s;
+
+	s = 0;
+	for (i = 0; i < n; i++) {
+		s = s + t[i];
+	}
+	return s;
+}
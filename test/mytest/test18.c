@@ -0,0 +1,32 @@
+extern void * MALLOC(int);
+extern void FREE(void *);
+extern void PRINT(int);
+extern void MEMCPY(int *, int *, int);
+extern void MEMSET(int *, int, int);
+extern int MEMCMP(int *, int *, int);
+extern void SORT(int *, int);
+
+int main() {
+	int a[8];
+	int *b;
+	int i;
+	b = (int *)MALLOC(sizeof(int) * 8);
+	for (i = 0; i < 8; i = i + 1) {
+		a[i] = 7 - i * 3;
+	}
+	SORT(a, 8);
+	for (i = 0; i < 8; i = i + 1) {
+		PRINT(a[i]);
+	}
+	MEMCPY(b, a, 8);
+	PRINT(MEMCMP(a, b, 8));
+	MEMSET(b, 3, 4);
+	PRINT(MEMCMP(a, b, 8));
+	PRINT(MEMCMP(b, a, 8));
+	MEMCPY(a + 1, a, 7);
+	PRINT(a[0]);
+	PRINT(a[1]);
+	PRINT(a[7]);
+	FREE(b);
+	return 0;
+}
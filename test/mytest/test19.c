@@ -0,0 +1,34 @@
+extern void * MALLOC(int);
+extern void FREE(void *);
+extern void PRINT(int);
+
+int next[100000];
+
+int length(int node) {
+	if (node < 0) {
+		return 0;
+	}
+	return 1 + length(next[node]);
+}
+
+int sum(int *vals, int node) {
+	if (node < 0) {
+		return 0;
+	}
+	return vals[node] + sum(vals, next[node]);
+}
+
+int main() {
+	int *vals;
+	int i;
+	vals = (int *)MALLOC(sizeof(int) * 100000);
+	for (i = 0; i < 100000; i = i + 1) {
+		next[i] = i + 1;
+		vals[i] = 3;
+	}
+	next[99999] = -1;
+	PRINT(length(0));
+	PRINT(sum(vals, 50000));
+	FREE(vals);
+	return 0;
+}
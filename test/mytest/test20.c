@@ -0,0 +1,63 @@
+extern void PRINT(int);
+
+int calls;
+
+int touch(int v) {
+	calls = calls + 1;
+	return v;
+}
+
+int main() {
+	int a[5];
+	int *p;
+	int i;
+	int x;
+	int y;
+
+	if (touch(0) && touch(1)) {
+		PRINT(-1);
+	}
+	if (touch(1) || touch(0)) {
+		PRINT(calls);
+	}
+	if (touch(1) && !touch(0)) {
+		PRINT(calls);
+	}
+	x = touch(3) > 2 ? touch(10) : touch(20);
+	PRINT(x);
+	PRINT(calls);
+
+	for (i = 0; i < 5; i++) {
+		a[i] = i * 10;
+	}
+	i = 0;
+	a[i++] += 7;
+	PRINT(a[0]);
+	PRINT(i);
+	a[++i] -= 3;
+	PRINT(a[2]);
+	p = a;
+	p += 3;
+	PRINT(*p);
+	PRINT(*p++);
+	PRINT(*p);
+	p--;
+	PRINT(*--p);
+
+	x = 17;
+	x %= 5;
+	PRINT(x);
+	x *= 4;
+	x /= 3;
+	PRINT(x);
+	PRINT(17 % 4);
+	PRINT(x != 2);
+	PRINT(x != 3);
+	x = y = 9;
+	PRINT(x + y);
+	i = 10;
+	while (i-- > 7) {
+		PRINT(i);
+	}
+	return 0;
+}
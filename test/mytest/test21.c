@@ -0,0 +1,111 @@
+extern void PRINT(int);
+
+int dense(int v) {
+	int r;
+	r = 0;
+	switch (v) {
+	case 0:
+		r = 10;
+		break;
+	case 1:
+	case 2:
+		r = 20;
+		break;
+	case 3:
+		r = 30;
+	case 4:
+		r = r + 40;
+		break;
+	default:
+		r = -1;
+	}
+	return r;
+}
+
+int sparse(int v) {
+	switch (v) {
+	case -100000:
+		return 1;
+	case 7:
+		return 2;
+	case 1000000:
+		return 3;
+	}
+	return 0;
+}
+
+int main() {
+	int i;
+	int j;
+	int sum;
+
+	for (i = -1; i < 6; i++) {
+		PRINT(dense(i));
+	}
+	PRINT(sparse(-100000));
+	PRINT(sparse(7));
+	PRINT(sparse(1000000));
+	PRINT(sparse(8));
+
+	sum = 0;
+	for (i = 0; i < 10; i++) {
+		if (i % 2 == 0) {
+			continue;
+		}
+		if (i > 7) {
+			break;
+		}
+		sum = sum + i;
+	}
+	PRINT(sum);
+
+	i = 0;
+	sum = 0;
+	while (1) {
+		i++;
+		if (i == 3) {
+			continue;
+		}
+		if (i > 6) {
+			break;
+		}
+		sum = sum + i;
+	}
+	PRINT(sum);
+
+	i = 0;
+	do {
+		i = i + 3;
+	} while (i < 10);
+	PRINT(i);
+
+	i = 0;
+	do {
+		i++;
+		if (i < 4) {
+			continue;
+		}
+		PRINT(i);
+	} while (i < 5);
+
+	sum = 0;
+	for (i = 0; i < 4; i++) {
+		switch (i) {
+		case 1:
+			continue;
+		case 2:
+			for (j = 0; j < 10; j++) {
+				if (j == 2) {
+					break;
+				}
+				sum = sum + 100;
+			}
+			break;
+		default:
+			sum = sum + 1;
+		}
+		sum = sum + 1000;
+	}
+	PRINT(sum);
+	return 0;
+}
@@ -0,0 +1,109 @@
+extern void * MALLOC(int);
+extern void FREE(void *);
+extern void PRINT(int);
+
+struct point {
+	int x;
+	int y;
+};
+
+struct rect {
+	struct point lo;
+	struct point hi;
+	int tag[3];
+};
+
+union word {
+	int i;
+	char c;
+};
+
+struct node {
+	int val;
+	struct node *next;
+};
+
+struct point origin;
+
+int area(struct rect r) {
+	r.tag[0] = 99;
+	return (r.hi.x - r.lo.x) * (r.hi.y - r.lo.y);
+}
+
+struct point mid(struct point a, struct point b) {
+	struct point m;
+	m.x = (a.x + b.x) / 2;
+	m.y = (a.y + b.y) / 2;
+	return m;
+}
+
+void shift(struct point *p, int d) {
+	p->x += d;
+	(*p).y = (*p).y + d;
+}
+
+int main() {
+	struct rect r;
+	struct point pts[4];
+	struct point *p;
+	struct point q;
+	struct node *head;
+	struct node *n;
+	union word w;
+	int *ip;
+	int i;
+	int sum;
+
+	PRINT(origin.x + origin.y);
+	r.lo.x = 1;
+	r.lo.y = 2;
+	r.hi.x = 5;
+	r.hi.y = 7;
+	r.tag[0] = 4;
+	r.tag[2] = 6;
+	PRINT(area(r));
+	PRINT(r.tag[0] + r.tag[2]);
+
+	for (i = 0; i < 4; i++) {
+		pts[i].x = i;
+		pts[i].y = i * i;
+	}
+	p = pts;
+	p++;
+	p = p + 1;
+	PRINT(p->y);
+	PRINT((p - 1)->x);
+	shift(&pts[3], 10);
+	PRINT(pts[3].x);
+	PRINT(pts[3].y);
+
+	q = mid(pts[0], pts[3]);
+	PRINT(q.x);
+	PRINT(q.y);
+	q = r.hi;
+	q.x = 0;
+	PRINT(q.x + q.y + r.hi.x);
+	ip = &q.y;
+	*ip = 3;
+	PRINT(q.y);
+
+	w.i = 65;
+	PRINT(w.c);
+
+	head = 0;
+	for (i = 1; i <= 5; i++) {
+		n = (struct node *)MALLOC(sizeof(struct node));
+		n->val = i * 10;
+		n->next = head;
+		head = n;
+	}
+	sum = 0;
+	while (head) {
+		n = head;
+		sum = sum * 2 + n->val;
+		head = head->next;
+		FREE(n);
+	}
+	PRINT(sum);
+	return 0;
+}
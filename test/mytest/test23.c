@@ -0,0 +1,33 @@
+extern void * MALLOC(int);
+extern void FREE(void *);
+extern void PRINT(int);
+
+int big[4000000];
+
+int main() {
+	int *heap;
+	int small[4];
+	int i;
+	int sum;
+
+	sum = 0;
+	for (i = 0; i < 4000000; i = i + 500000) {
+		sum = sum + big[i];
+	}
+	PRINT(sum);
+	big[3999999] = 7;
+	big[0] = 5;
+	PRINT(big[0] + big[3999999]);
+
+	heap = (int *)MALLOC(sizeof(int) * 2000000);
+	heap[1999999] = 11;
+	heap[0] = heap[1999999] * 2;
+	PRINT(heap[0]);
+	FREE(heap);
+
+	for (i = 0; i < 4; i++) {
+		small[i] = i;
+	}
+	PRINT(small[3]);
+	return 0;
+}
@@ -0,0 +1,54 @@
+extern void PRINT(int);
+
+const int N = 6;
+int squares[] = {0, 1, 4, 9, 16, 25};
+int scaled = N * 4;
+int table[8] = {3, 1, 4};
+int *cursor = &squares[2];
+int *empty = 0;
+char letter = 'q';
+
+struct pair {
+	int key;
+	int value;
+};
+
+struct pair pairs[3] = {{1, 10}, {2, 20}, {3, 30}};
+struct pair *last = &pairs[2];
+int *inner = &pairs[1].value;
+
+int counter() {
+	static int calls = 100;
+	calls = calls + 1;
+	return calls;
+}
+
+int main() {
+	int i;
+	int sum;
+	int local[5] = {7, 8, 9};
+	struct pair p = {4, N * 5};
+
+	sum = 0;
+	for (i = 0; i < N; i++) {
+		sum = sum + squares[i];
+	}
+	PRINT(sum);
+	PRINT(scaled);
+	PRINT(table[0] + table[2] + table[7]);
+	PRINT(*cursor);
+	cursor++;
+	PRINT(*cursor);
+	if (!empty) {
+		PRINT(1);
+	}
+	PRINT(letter);
+	PRINT(last->key + last->value);
+	PRINT(*inner);
+	PRINT(pairs[0].value);
+	PRINT(counter());
+	PRINT(counter());
+	PRINT(local[0] + local[2] + local[4]);
+	PRINT(p.key + p.value);
+	return 0;
+}
@@ -0,0 +1,53 @@
+extern void PRINT(int);
+
+struct cell {
+	int a;
+	int b;
+	int c;
+};
+
+int main() {
+	int arr[6];
+	int grid[3][4];
+	struct cell cells[4];
+	struct cell *cp;
+	int *p;
+	int *q;
+	int i;
+	int j;
+	int sum;
+
+	for (p = arr; p < arr + 6; p++) {
+		*p = p - arr;
+	}
+	q = &arr[5];
+	PRINT(q - arr);
+	p = arr;
+	PRINT(p != q);
+	PRINT(p == arr);
+	PRINT(q >= p);
+	sum = 0;
+	while (q > p) {
+		sum = sum + *q;
+		q -= 2;
+	}
+	PRINT(sum);
+
+	for (i = 0; i < 3; i++) {
+		for (j = 0; j < 4; j++) {
+			grid[i][j] = i * 10 + j;
+		}
+	}
+	PRINT(grid[2][3] - grid[1][1]);
+
+	for (i = 0; i < 4; i++) {
+		cells[i].c = i * 3;
+	}
+	cp = cells + 3;
+	PRINT(cp - cells);
+	PRINT(cp->c);
+	cp--;
+	PRINT((*cp).c);
+	PRINT(-sum * 7 / 3 % 5);
+	return 0;
+}
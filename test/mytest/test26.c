@@ -0,0 +1,48 @@
+extern void PRINT(int);
+
+void swap(int *a, int *b) {
+	int t;
+	t = *a;
+	*a = *b;
+	*b = t;
+}
+
+int fib(int n) {
+	int a;
+	int b;
+	if (n < 2) {
+		return n;
+	}
+	a = fib(n - 1);
+	b = fib(n - 2);
+	return a + b;
+}
+
+int main() {
+	int x;
+	int y;
+	int i;
+	int acc;
+	int *p;
+
+	x = 3;
+	y = 8;
+	swap(&x, &y);
+	PRINT(x);
+	PRINT(y);
+
+	acc = 0;
+	for (i = 0; i < 100; i++) {
+		int sq = i * i;
+		acc += sq % 7;
+	}
+	PRINT(acc);
+
+	p = &acc;
+	*p = *p + fib(15);
+	PRINT(acc);
+	i = 5;
+	PRINT(i++);
+	PRINT(++i);
+	return 0;
+}
@@ -0,0 +1,55 @@
+extern void PRINT(int);
+
+int sq(int x) {
+	return x * x;
+}
+
+int sumsq(int a, int b) {
+	int s;
+	s = sq(a) + sq(b);
+	return s;
+}
+
+int clamp(int v, int lo, int hi) {
+	if (v < lo) {
+		return lo;
+	}
+	if (v > hi) {
+		return hi;
+	}
+	return v;
+}
+
+void bump(int *p) {
+	*p = *p + 1;
+}
+
+int addr(int v) {
+	int *p;
+	p = &v;
+	return *p + 1;
+}
+
+int fact(int n) {
+	if (n <= 1) {
+		return 1;
+	}
+	return n * fact(n - 1);
+}
+
+int main() {
+	int i;
+	int total;
+
+	total = 0;
+	for (i = 0; i < 10; i++) {
+		total = total + sumsq(i, i + 1);
+		total = total + clamp(i * 7, 10, 40);
+		bump(&total);
+	}
+	PRINT(total);
+	PRINT(addr(4));
+	PRINT(fact(6));
+	PRINT(sumsq(clamp(-5, 0, 3), sq(2)));
+	return 0;
+}
@@ -0,0 +1,56 @@
+extern void PRINT(int);
+
+int a[64];
+int b[64];
+int m[8][8];
+int rows[8];
+
+int weight(int x, int y) {
+	int w;
+	w = x * 3 + y;
+	if (w % 2 == 0) {
+		w = w / 2;
+	}
+	return w;
+}
+
+int main() {
+	int n;
+	int i;
+	int j;
+	int total;
+
+	n = 64;
+#pragma omp parallel for
+	for (int k = 0; k < n; k++) {
+		a[k] = k * k - 3 * k;
+	}
+
+#pragma omp parallel for
+	for (int k = 0; k <= n - 2; k += 2) {
+		b[k] = a[k] + a[k + 1];
+		b[k + 1] = a[k] - a[k + 1];
+	}
+
+#pragma omp parallel for
+	for (i = 0; i < 8; i++) {
+		int s;
+		s = 0;
+		for (int c = 0; c < 8; c++) {
+			m[i][c] = weight(i, c);
+			s = s + m[i][c];
+		}
+		rows[i] = s;
+	}
+
+	total = 0;
+	for (j = 0; j < 64; j++) {
+		total = total + a[j] + b[j];
+	}
+	PRINT(total);
+	for (j = 0; j < 8; j++) {
+		PRINT(rows[j]);
+	}
+	PRINT(m[7][7]);
+	return 0;
+}
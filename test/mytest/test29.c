@@ -0,0 +1,87 @@
+extern void PRINT(int);
+extern int *MALLOC(int);
+extern void FREE(int *);
+
+int a[200];
+
+int scale(int x, int k) {
+	int i;
+	int s;
+	s = 0;
+	i = 0;
+	while (i < x) {
+		s = s + i * k;
+		i += 2;
+	}
+	return s;
+}
+
+int main() {
+	int n;
+	int m;
+	int k;
+	int i;
+	int j;
+	int s;
+	int *p;
+
+	n = 4;
+	m = 5;
+	k = 3;
+	for (i = 0; i < n * m; i = i + 1) {
+		a[i * k] = i + n * m;
+	}
+	s = 0;
+	for (i = 0; i < 60; i++) {
+		s = s + a[i];
+	}
+	PRINT(s);
+
+	s = 0;
+	for (i = 0; i < 5; i++) {
+		s = s + k * 2 + i * k;
+		k = k + 1;
+	}
+	PRINT(s);
+
+	s = 0;
+	for (i = 20; i > 0; i--) {
+		if (i % 3 == 0) {
+			i = i - 1;
+			continue;
+		}
+		if (i * m < 20) {
+			break;
+		}
+		s = s + i * m;
+	}
+	PRINT(s);
+	PRINT(i);
+
+	s = 0;
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < m; j++) {
+			s = s + i * m + j * k + n * m;
+		}
+	}
+	PRINT(s);
+
+	p = MALLOC(40);
+	for (i = 0; i < 10; i++) {
+		int t;
+		t = i * k;
+		*(p + i) = t + (m - n);
+	}
+	s = 0;
+	j = 9;
+	while (j >= 0) {
+		s = s + p[j] * (j + 1);
+		j = j - 1;
+	}
+	PRINT(s);
+	FREE(p);
+
+	PRINT(scale(10, 7));
+	PRINT(scale(0, 7));
+	return 0;
+}
@@ -0,0 +1,32 @@
+extern void PRINT(int);
+
+int classify(int x) {
+	return x % 4;
+}
+
+int main() {
+	int i;
+	int s;
+
+	s = 0;
+	for (i = 0; i < 10; i++) {
+		switch (classify(i)) {
+		case 0:
+			s = s + 1;
+			break;
+		case 1:
+			s = s + 10;
+			break;
+		default:
+			s = s + 100;
+		}
+		if (classify(i)) {
+			s = s + 1000;
+		}
+		s = s + (classify(i) ? 3 : 7);
+	}
+	PRINT(s);
+	PRINT(classify(7) && classify(8));
+	PRINT(classify(7) || classify(8));
+	return 0;
+}
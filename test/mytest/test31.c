@@ -0,0 +1,38 @@
+extern void PRINT(int);
+
+int a[40];
+
+int main() {
+	int i;
+	int total;
+
+#pragma omp parallel for
+	for (int k = 0; k < 40; k++) {
+		a[k] = -1;
+		if (k % 3 == 0) {
+			continue;
+		}
+		for (int c = 0; c < 4; c++) {
+			if (c == k % 4) {
+				continue;
+			}
+			a[k] = a[k] + c;
+		}
+		switch (k % 5) {
+		case 1:
+			continue;
+		default:
+			a[k] = a[k] * 2;
+		}
+	}
+
+	total = 0;
+	for (i = 0; i < 40; i++) {
+		total = total * 3 % 10007 + a[i];
+	}
+	PRINT(total);
+	PRINT(a[3]);
+	PRINT(a[11]);
+	PRINT(a[7]);
+	return 0;
+}
@@ -0,0 +1,10 @@
+extern void PRINT(int);
+extern void *MALLOC(int);
+int g;
+int *p;
+g = 40; p = (int *)MALLOC(sizeof(int)); *p = 2;
+PRINT(g + *p);
+PRINT(1); g = undeclared;
+if (g == 40) {
+	PRINT(g);
+}
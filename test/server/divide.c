@@ -0,0 +1,9 @@
+extern int GET();
+extern void PRINT(int);
+
+int main() {
+	int n;
+	n = GET();
+	PRINT(100 / n);
+	return 0;
+}
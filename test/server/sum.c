@@ -0,0 +1,15 @@
+extern int GET();
+extern void PRINT(int);
+
+int main() {
+	int n;
+	int sum;
+	n = GET();
+	sum = 0;
+	while (n > 0) {
+		sum = sum + GET();
+		n = n - 1;
+	}
+	PRINT(sum);
+	return 0;
+}
@@ -0,0 +1,80 @@
+#include "Program.h"
+#include "gtest/gtest.h"
+
+static const char *kCounter = R"(
+extern void PRINT(int);
+
+int total = 10;
+
+int add(int n) {
+	total = total + n;
+	return total;
+}
+
+int sum(int *a, int n) {
+	int s = 0;
+	int i;
+	for (i = 0; i < n; i = i + 1) {
+		s = s + a[i];
+	}
+	return s;
+}
+
+int spin(int n) {
+	while (n > 0) {
+	}
+	return 0;
+}
+)";
+
+TEST(Program, lookup) {
+	std::unique_ptr<Program> program = Program::load(kCounter);
+	ASSERT_NE(program, nullptr);
+	const Program::Function *add = program->lookup("add");
+	ASSERT_NE(add, nullptr);
+	ASSERT_EQ(add->Arity, 1u);
+	ASSERT_EQ(program->lookup("add"), add);
+	ASSERT_EQ(program->lookup("missing"), nullptr);
+	ASSERT_EQ(program->lookup("PRINT"), nullptr);
+}
+
+TEST(Program, globalsPersist) {
+	std::unique_ptr<Program> program = Program::load(kCounter);
+	const Program::Function *add = program->lookup("add");
+	long result = 0;
+	ASSERT_EQ(program->call(*add, {5}, result), RunStatus::Finished);
+	ASSERT_EQ(result, 15);
+	ASSERT_EQ(program->call(*add, {-3}, result), RunStatus::Finished);
+	ASSERT_EQ(result, 12);
+}
+
+TEST(Program, pointerArgument) {
+	std::unique_ptr<Program> program = Program::load(kCounter);
+	long *a = program->allocate(4);
+	for (long i = 0; i < 4; ++i) {
+		a[i] = i * i;
+	}
+	long result = 0;
+	ASSERT_EQ(program->call(*program->lookup("sum"),
+	                        {reinterpret_cast<long>(a), 4}, result),
+	          RunStatus::Finished);
+	ASSERT_EQ(result, 14);
+	program->release(a);
+}
+
+TEST(Program, budget) {
+	std::unique_ptr<Program> program = Program::load(kCounter);
+	program->setBudget(ExecutionBudget{10000, 0});
+	long result = -1;
+	ASSERT_EQ(program->call(*program->lookup("spin"), {1}, result),
+	          RunStatus::BudgetExceeded);
+	ASSERT_EQ(result, -1);
+	// the program is still usable afterwards
+	ASSERT_EQ(program->call(*program->lookup("add"), {1}, result),
+	          RunStatus::Finished);
+	ASSERT_EQ(result, 11);
+}
+
+TEST(Program, compileError) {
+	ASSERT_EQ(Program::load("int f( {"), nullptr);
+}